@@ -0,0 +1,143 @@
+// A set of independent heaps (arenas) shared between threads - implementation
+
+#define _GNU_SOURCE
+#include <sched.h>
+
+#include "arena.h"
+
+// the number of threads that have been dealt an arena so far
+u32int arena_tickets = 0;
+
+// the calling thread's ticket, plus one (0 if it has none yet)
+__thread u32int arena_ticket = 0;
+
+// headers for local functions
+void *arena_align_up(void *p);
+
+// returns p rounded up to the next page boundary
+void *arena_align_up(void *p)
+{
+   return (void *)(((size_t)p + PAGE_SIZE - 1) & PAGE_MASK);
+}
+
+struct arenas *arenas_create(void *start,
+                             void *end,
+                             void *max,
+                             size_t count,
+                             u32int policy,
+                             u32int flags)
+{
+   struct arenas *arenas = (struct arenas *)start;
+   size_t initial;
+   size_t i;
+
+   if(count == 0 || count > ARENA_MAX) {
+      return NULL;
+   }
+
+   // | arenas struct | arena 0 | arena 1 | ... | arena count - 1 |
+   arenas->count = count;
+   arenas->policy = policy;
+   arenas->base = arena_align_up(start + sizeof(struct arenas));
+   if(max <= arenas->base) {
+      return NULL;
+   }
+   arenas->stride = ((max - arenas->base) / count) & PAGE_MASK;
+
+   // each arena starts with an equal share of the initial region
+   initial = 0;
+   if(end > arenas->base) {
+      initial = ((end - arenas->base) / count) & PAGE_MASK;
+   }
+
+   // the heap struct, its free list and at least a page of data have to fit
+   // in the initial share
+   if(initial < sizeof(struct heap) + 2 * PAGE_SIZE +
+                FREE_LIST_ENTRY_SIZE * HEAP_FREE_LIST_INITIAL)
+   {
+      return NULL;
+   }
+
+   for(i = 0; i < count; i++)
+   {
+      void *slice = arenas->base + i * arenas->stride;
+
+      arenas->heaps[i] = heap_create_flags(slice,
+                                           slice + initial,
+                                           slice + arenas->stride,
+                                           flags);
+   }
+
+   return arenas;
+}
+
+size_t arena_home(struct arenas *arenas)
+{
+   if(arenas->policy == ARENA_BY_CPU)
+   {
+      int cpu = sched_getcpu();
+      if(cpu >= 0) {
+         return (size_t)cpu % arenas->count;
+      }
+   }
+
+   // round robin, or the CPU is unknown: deal the thread a ticket the first
+   // time it asks, and keep it
+   if(arena_ticket == 0) {
+      arena_ticket = __atomic_add_fetch(&arena_tickets, 1, __ATOMIC_RELAXED);
+   }
+
+   return (arena_ticket - 1) % arenas->count;
+}
+
+struct heap *arena_owner(void *p, struct arenas *arenas)
+{
+   size_t i;
+
+   if(p < arenas->base) {
+      return NULL;
+   }
+
+   i = (p - arenas->base) / arenas->stride;
+   if(i >= arenas->count) {
+      return NULL;
+   }
+
+   return arenas->heaps[i];
+}
+
+void *kalloc_arena(size_t size, u8int page_align, struct arenas *arenas)
+{
+   size_t home = arena_home(arenas);
+   size_t i;
+
+   // start at the home arena, and move on to the others only if it is full
+   for(i = 0; i < arenas->count; i++)
+   {
+      struct heap *heap = arenas->heaps[(home + i) % arenas->count];
+      void *p;
+
+      spinlock_acquire(&heap->lock);
+      p = kalloc_heap(size, page_align, heap);
+      spinlock_release(&heap->lock);
+
+      if(p != NULL) {
+         return p;
+      }
+   }
+
+   return NULL;
+}
+
+void kfree_arena(void *p, struct arenas *arenas)
+{
+   struct heap *heap = arena_owner(p, arenas);
+
+   if(heap == NULL) {
+      return;
+   }
+
+   spinlock_acquire(&heap->lock);
+   kfree_heap(p, heap);
+   spinlock_release(&heap->lock);
+}
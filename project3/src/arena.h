@@ -0,0 +1,60 @@
+// A set of independent heaps (arenas) shared between threads
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "common.h"
+#include "kheap.h"
+
+// the region given to arenas_create is carved into equal slices, one per
+// arena, and each slice holds a complete heap with its own lock and free list.
+// Each thread allocates from its home arena, so threads in different arenas
+// never contend; a pointer is routed back to the arena that owns it from its
+// address alone, so any thread can free any block
+//
+// every arena has its own free list, which starts small and grows with the
+// number of holes in the arena (see HEAP_FREE_LIST_INITIAL)
+
+#define ARENA_MAX         64
+
+// ways of choosing a thread's home arena
+#define ARENA_ROUND_ROBIN 0 // threads are dealt arenas in turn, once
+#define ARENA_BY_CPU      1 // the arena of the CPU the thread is running on
+
+// the main arena set struct
+struct arenas
+{
+   struct heap *heaps[ARENA_MAX];
+   size_t count;       // the number of arenas
+   void *base;         // the start of the first arena's slice
+   size_t stride;      // the size of each arena's slice
+   u32int policy;      // ARENA_ROUND_ROBIN or ARENA_BY_CPU
+};
+
+// creates count arenas over a region, as heap_create does for one heap
+// the struct arenas is placed at start, and each arena starts out with an
+// equal share of [start,end) and may grow into an equal share of [start,max)
+// flags are the HEAP_* flags for each arena's heap
+// returns NULL if count is 0 or too large, or the slices would be too small
+struct arenas *arenas_create(void *start,
+                             void *end,
+                             void *max,
+                             size_t count,
+                             u32int policy,
+                             u32int flags);
+
+// allocates memory, as kalloc_heap, from the calling thread's home arena
+// if the home arena is full, the other arenas are tried in turn
+void *kalloc_arena(size_t size, u8int page_align, struct arenas *arenas);
+
+// releases memory allocated with kalloc_arena, from any thread
+void kfree_arena(void *p, struct arenas *arenas);
+
+// returns the arena that owns a pointer, or NULL if the pointer is not in
+// any of the arenas
+struct heap *arena_owner(void *p, struct arenas *arenas);
+
+// returns the index of the calling thread's home arena
+size_t arena_home(struct arenas *arenas);
+
+#endif // ARENA_H
@@ -0,0 +1,67 @@
+// Memset throughput of each variant, for a range of fill sizes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../memset.h"
+
+#define FILL_MIN            64
+#define FILL_MAX            (64 * 1024 * 1024)    // 64MiB
+#define BYTES_PER_SIZE      (256 * 1024 * 1024)   // bytes filled for each size
+
+// returns the current time in nanoseconds
+double now(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+   const char *names[] = {"bytes", "words", "sse2", "avx2"};
+   unsigned char *memory = malloc(FILL_MAX);
+   u32int variant;
+   size_t size;
+
+   printf("%12s", "fill");
+   for(variant = MEMSET_BYTES; variant <= memset_best(); variant++) {
+      printf(" %10s GB/s", names[variant]);
+   }
+   printf("\n");
+
+   for(size = FILL_MIN; size <= FILL_MAX; size *= 16)
+   {
+      printf("%10zuB ", size);
+
+      for(variant = MEMSET_BYTES; variant <= memset_best(); variant++)
+      {
+         size_t rounds = BYTES_PER_SIZE / size;
+         size_t i;
+         double start;
+
+         // the byte loop is slow enough that a tenth of the work will do
+         if(variant == MEMSET_BYTES) {
+            rounds = (rounds + 9) / 10;
+         }
+
+         memset_use(variant);
+         memset(memory, 1, size);
+
+         start = now();
+         for(i = 0; i < rounds; i++) {
+            memset(memory, i, size);
+         }
+
+         printf(" %15.2f", (double)rounds * size / (now() - start));
+      }
+
+      printf("\n");
+   }
+
+   free(memory);
+
+   return 0;
+}
@@ -0,0 +1,168 @@
+// Sorted array operations through the comparison function pointer
+// (sorted_array) against the type-specialized version (sorted_array_gen.h)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../sorted_array.h"
+#include "sorted_array_gen.h"
+
+#define OPERATIONS          (1 << 20)  // inserts and removes per size
+#define LOOKUPS             (1 << 20)
+
+// an item, padded to a cache line as a hole header would be spread out
+struct item
+{
+   size_t key;
+   char padding[56];
+};
+
+// orders items by key, then address, as the heap orders holes
+s8int item_compare(void *a, void *b)
+{
+   size_t a_key = ((struct item *)a)->key;
+   size_t b_key = ((struct item *)b)->key;
+
+   if(a_key != b_key) {
+      return (a_key < b_key) ? -1 : 1;
+   }
+   if(a == b) {
+      return 0;
+   }
+
+   return (a < b) ? -1 : 1;
+}
+
+// returns -1 if the item's key is less than the key
+s8int item_before_key(void *item, void *key)
+{
+   return (((struct item *)item)->key < *(size_t *)key) ? -1 : 1;
+}
+
+#define ITEM_BEFORE(item, key) ((item)->key < (key))
+
+SORTED_ARRAY_DECLARE(item_array, struct item *)
+SORTED_ARRAY_DEFINE(item_array, struct item *, size_t, item_compare,
+                    ITEM_BEFORE)
+
+// returns the current time in nanoseconds
+double now(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// times inserting, looking up and removing n items with each version, and
+// prints the average nanoseconds per operation
+void bench(size_t n)
+{
+   struct item *items = malloc(n * sizeof(struct item));
+   struct item **order = malloc(n * sizeof(struct item *));
+   size_t *keys = malloc(LOOKUPS * sizeof(size_t));
+   void **storage = malloc(n * sizeof(void *));
+   struct item **typed_storage = malloc(n * sizeof(struct item *));
+   size_t rounds = OPERATIONS / n;
+   size_t lookups = 0;
+   size_t found = 0;
+   double times[2][3] = {{0}};
+   double start;
+   size_t i, round;
+
+   srand(1);
+   for(i = 0; i < n; i++)
+   {
+      items[i].key = rand() % (4 * n);
+      order[i] = &items[i];
+   }
+   for(i = n - 1; i > 0; i--)
+   {
+      size_t j = rand() % (i + 1);
+      struct item *tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+   }
+   for(i = 0; i < LOOKUPS; i++) {
+      keys[i] = rand() % (4 * n);
+   }
+
+   struct sorted_array array = sorted_array_place(storage, n, &item_compare);
+   struct item_array typed = item_array_place(typed_storage, n);
+
+   for(round = 0; round < rounds; round++)
+   {
+      // through the function pointer
+      start = now();
+      for(i = 0; i < n; i++) {
+         sorted_array_insert(order[i], &array);
+      }
+      times[0][0] += now() - start;
+
+      start = now();
+      for(i = 0; i < LOOKUPS; i += rounds) {
+         found += sorted_array_lower_bound(&keys[i], &item_before_key,
+                                           &array);
+      }
+      times[0][1] += now() - start;
+
+      start = now();
+      for(i = 0; i < n; i++) {
+         sorted_array_remove(sorted_array_search(order[i], &array), &array);
+      }
+      times[0][2] += now() - start;
+
+      // specialized
+      start = now();
+      for(i = 0; i < n; i++) {
+         item_array_insert(order[i], &typed);
+      }
+      times[1][0] += now() - start;
+
+      start = now();
+      for(i = 0; i < LOOKUPS; i += rounds) {
+         found -= item_array_lower_bound(keys[i], &typed);
+      }
+      times[1][1] += now() - start;
+      lookups += (LOOKUPS + rounds - 1) / rounds;
+
+      start = now();
+      for(i = 0; i < n; i++) {
+         item_array_remove(item_array_search(order[i], &typed), &typed);
+      }
+      times[1][2] += now() - start;
+   }
+
+   if(found != 0 || array.size != 0 || typed.size != 0) {
+      printf("the two versions disagree\n");
+   }
+
+   printf("%10lu %12s %10.1f %16.1f %12.1f\n", n, "pointer",
+          times[0][0] / (rounds * n),
+          times[0][1] / lookups,
+          times[0][2] / (rounds * n));
+   printf("%10s %12s %10.1f %16.1f %12.1f\n", "", "specialized",
+          times[1][0] / (rounds * n),
+          times[1][1] / lookups,
+          times[1][2] / (rounds * n));
+
+   free(items);
+   free(order);
+   free(keys);
+   free(storage);
+   free(typed_storage);
+}
+
+int main(int argc, char **argv)
+{
+   size_t n;
+
+   printf("%10s %12s %10s %16s %12s\n", "items", "", "insert ns",
+          "lower bound ns", "remove ns");
+   for(n = 16; n <= 16384; n *= 4) {
+      bench(n);
+   }
+
+   return 0;
+}
@@ -0,0 +1,160 @@
+// Sorted arrays specialized on their item type, generated by macros
+
+#ifndef SORTED_ARRAY_GEN_H
+#define SORTED_ARRAY_GEN_H
+
+#include "../common.h"
+#include "../memcpy.h"
+
+// these work as sorted_array does, but for items of one type, with the
+// comparisons given by name when the array is defined rather than through a
+// function pointer, so that the compiler can inline them into the searches
+//
+// SORTED_ARRAY_DECLARE(name, type) declares
+//    struct name { type *storage; size_t size; size_t max_size; };
+// and SORTED_ARRAY_DEFINE(name, type, key_type, compare, before) defines
+//    struct name name_place(void *addr, size_t max_size);
+//    s8int name_insert(type item, struct name *array);
+//    size_t name_lower_bound(key_type key, struct name *array);
+//    size_t name_search(type item, struct name *array);
+//    type name_lookup(size_t i, struct name *array);
+//    void name_remove(size_t i, struct name *array);
+// where compare(a, b) returns -1 if item a comes before item b, 0 if they are
+// the same, and 1 otherwise, and before(item, key) is non-zero if the item
+// comes before the key (it has to agree with compare). Both may be macros or
+// functions. name_lookup returns a zeroed item if the index is invalid
+//
+// the declaration can go in a header, and the definition in the one file that
+// uses the functions
+//
+// the heap's free list outgrew this (it keeps the hole sizes in an array of
+// their own; see free_list.h), so only the sorted array benchmark uses it,
+// to measure what specializing the comparisons is worth
+
+// searches narrow the range with a binary search until it is this small, and
+// then scan it in order, which is cheaper than the remaining branches
+#define SORTED_ARRAY_LINEAR 8
+
+#define SORTED_ARRAY_DECLARE(name, type)                                      \
+struct name                                                                   \
+{                                                                             \
+   type *storage;                                                             \
+   size_t size;                                                               \
+   size_t max_size;                                                           \
+};
+
+#define SORTED_ARRAY_DEFINE(name, type, key_type, compare, before)            \
+                                                                              \
+static inline struct name name##_place(void *addr, size_t max_size)           \
+{                                                                             \
+   struct name array;                                                         \
+                                                                              \
+   array.storage = addr;                                                      \
+   array.size = 0;                                                            \
+   array.max_size = max_size;                                                 \
+                                                                              \
+   return array;                                                              \
+}                                                                             \
+                                                                              \
+static inline size_t name##_lower_bound(key_type key, struct name *array)     \
+{                                                                             \
+   size_t low = 0;                                                            \
+   size_t high = array->size;                                                 \
+                                                                              \
+   while(high - low > SORTED_ARRAY_LINEAR)                                    \
+   {                                                                          \
+      size_t middle = low + (high - low) / 2;                                 \
+                                                                              \
+      if(before(array->storage[middle], key)) {                               \
+         low = middle + 1;                                                    \
+      }                                                                       \
+      else {                                                                  \
+         high = middle;                                                       \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   while(low < high && before(array->storage[low], key)) {                    \
+      low++;                                                                  \
+   }                                                                          \
+                                                                              \
+   return low;                                                                \
+}                                                                             \
+                                                                              \
+/* the slot that an item goes in, after everything that comes before it */   \
+static inline size_t name##_slot(type item, struct name *array)               \
+{                                                                             \
+   size_t low = 0;                                                            \
+   size_t high = array->size;                                                 \
+                                                                              \
+   while(high - low > SORTED_ARRAY_LINEAR)                                    \
+   {                                                                          \
+      size_t middle = low + (high - low) / 2;                                 \
+                                                                              \
+      if(compare(array->storage[middle], item) < 0) {                         \
+         low = middle + 1;                                                    \
+      }                                                                       \
+      else {                                                                  \
+         high = middle;                                                       \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   while(low < high && compare(array->storage[low], item) < 0) {              \
+      low++;                                                                  \
+   }                                                                          \
+                                                                              \
+   return low;                                                                \
+}                                                                             \
+                                                                              \
+static inline s8int name##_insert(type item, struct name *array)              \
+{                                                                             \
+   size_t i;                                                                  \
+                                                                              \
+   if(array->size >= array->max_size) {                                       \
+      return -1;                                                              \
+   }                                                                          \
+                                                                              \
+   i = name##_slot(item, array);                                              \
+   memmove(&array->storage[i + 1], &array->storage[i],                        \
+           (array->size - i) * sizeof(type));                                 \
+   array->storage[i] = item;                                                  \
+   array->size++;                                                             \
+                                                                              \
+   return 0;                                                                  \
+}                                                                             \
+                                                                              \
+static inline size_t name##_search(type item, struct name *array)             \
+{                                                                             \
+   size_t i = name##_slot(item, array);                                       \
+                                                                              \
+   if(i < array->size && compare(array->storage[i], item) == 0) {             \
+      return i;                                                               \
+   }                                                                          \
+                                                                              \
+   return array->size;                                                        \
+}                                                                             \
+                                                                              \
+static inline type name##_lookup(size_t i, struct name *array)                \
+{                                                                             \
+   type none;                                                                 \
+                                                                              \
+   if(i >= array->size)                                                       \
+   {                                                                          \
+      memset(&none, 0, sizeof(type));                                         \
+      return none;                                                            \
+   }                                                                          \
+                                                                              \
+   return array->storage[i];                                                  \
+}                                                                             \
+                                                                              \
+static inline void name##_remove(size_t i, struct name *array)                \
+{                                                                             \
+   if(i >= array->size) {                                                     \
+      return;                                                                 \
+   }                                                                          \
+                                                                              \
+   memmove(&array->storage[i], &array->storage[i + 1],                        \
+           (array->size - i - 1) * sizeof(type));                             \
+   array->size--;                                                             \
+}
+
+#endif // SORTED_ARRAY_GEN_H
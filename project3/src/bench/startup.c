@@ -0,0 +1,74 @@
+// Startup cost: time to create a heap, and to make its first allocation,
+// against the size of the region
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../kheap.h"
+#include "../buddy.h"
+
+#define REGION_MIN          (64 * 1024)           // 64KiB
+#define REGION_MAX          (256 * 1024 * 1024)   // 256MiB
+#define REPETITIONS         1000
+
+// returns the current time in nanoseconds
+double now(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+   // one space, reused by every heap, as short-lived heaps would be
+   void *space = malloc(REGION_MAX);
+   size_t region;
+   int i;
+
+   printf("%12s %16s %16s %16s\n", "region", "heap_create ns", "first alloc ns",
+          "buddy_create ns");
+
+   for(region = REGION_MIN; region <= REGION_MAX; region *= 4)
+   {
+      double create = 0;
+      double first = 0;
+      double buddy = 0;
+
+      for(i = 0; i < REPETITIONS; i++)
+      {
+         double start = now();
+         struct heap *heap = heap_create(space, space + region,
+                                         space + region);
+         double created = now();
+         void *p = kalloc_heap(64, 0, heap);
+         double allocated = now();
+
+         if(p == NULL)
+         {
+            printf("allocation failed\n");
+            return 1;
+         }
+
+         create += created - start;
+         first += allocated - created;
+
+         start = now();
+         if(buddy_create(space, space + region, space + region) == NULL)
+         {
+            printf("buddy_create failed\n");
+            return 1;
+         }
+         buddy += now() - start;
+      }
+
+      printf("%10zuKi %16.0f %16.0f %16.0f\n", region / 1024,
+             create / REPETITIONS, first / REPETITIONS, buddy / REPETITIONS);
+   }
+
+   free(space);
+
+   return 0;
+}
@@ -0,0 +1,225 @@
+// Allocation latency under synthetic workloads: throughput, latency
+// percentiles, and fragmentation of kalloc_heap and kfree_heap
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../kheap.h"
+
+#define SPACE_SIZE          (256 * 1024 * 1024) // 256MiB
+#define INITIAL_SIZE        (1024 * 1024)       // 1MiB
+
+#define LIVE                10000 // blocks allocated before any is freed
+#define ROUNDS              10    // the most rounds any workload runs
+#define GROWTH_INITIAL      (64 * 1024)         // 64KiB
+#define GROWTH_SIZE         4096  // block size for the growth workload
+
+// the order blocks are freed in
+#define FREE_LIFO           0
+#define FREE_FIFO           1
+#define FREE_RANDOM         2
+
+// a workload: block sizes are picked from [min_size, max_size]
+struct workload
+{
+   const char *name;
+   size_t min_size;
+   size_t max_size;
+   size_t alignment;
+   u32int order;
+   u32int rounds;
+};
+
+// page-aligned allocations are much slower, so they run fewer rounds
+struct workload workloads[] =
+{
+   { "same-size lifo",      64,   64,         1, FREE_LIFO,   ROUNDS },
+   { "same-size fifo",      64,   64,         1, FREE_FIFO,   ROUNDS },
+   { "same-size random",    64,   64,         1, FREE_RANDOM, ROUNDS },
+   { "variable lifo",       16, 4096,         1, FREE_LIFO,   ROUNDS },
+   { "variable fifo",       16, 4096,         1, FREE_FIFO,   ROUNDS },
+   { "variable random",     16, 4096,         1, FREE_RANDOM, ROUNDS },
+   { "64-aligned random",   16, 4096,        64, FREE_RANDOM, ROUNDS },
+   { "page-aligned random", 16, 4096, PAGE_SIZE, FREE_RANDOM, 2 },
+};
+
+// latencies of every operation in a workload, in nanoseconds
+double latencies[2 * LIVE * ROUNDS];
+size_t operations;
+
+void *blocks[LIVE];
+size_t order[LIVE];
+
+// returns the current time in nanoseconds
+double now(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// sorts latencies for qsort
+int compare_latency(const void *a, const void *b)
+{
+   double x = *(const double *)a;
+   double y = *(const double *)b;
+
+   return (x > y) - (x < y);
+}
+
+// returns one minus the largest hole's share of the free space in the heap:
+// 0 if the free space is all in one hole, near 1 if it is in many small ones
+double fragmentation(struct heap *heap)
+{
+   struct heap_stats stats;
+
+   heap_stats(heap, &stats);
+
+   return (stats.free == 0) ? 0 : 1 - (double)stats.largest_hole / stats.free;
+}
+
+// prints a line of results for the latencies recorded so far
+void report(const char *name, double elapsed, double fragmented,
+            double overhead)
+{
+   qsort(latencies, operations, sizeof(double), &compare_latency);
+
+   printf("%-20s %10.0f %8.0f %8.0f %8.0f %8.2f %8.2f\n", name,
+          operations / (elapsed / 1e9),
+          latencies[operations / 2],
+          latencies[operations * 99 / 100],
+          latencies[operations * 999 / 1000],
+          fragmented, overhead);
+}
+
+// times one workload: each round allocates LIVE blocks, and then frees them
+// all in the workload's order
+// fragmentation is measured halfway through freeing, and overhead (the heap
+// size over the bytes requested) when every block is allocated; both are
+// averaged over the rounds
+void run(struct workload *workload, void *space)
+{
+   struct heap *heap = heap_create(space, space + INITIAL_SIZE,
+                                   space + SPACE_SIZE);
+   double elapsed = 0;
+   double fragmented = 0;
+   double overhead = 0;
+   size_t round;
+   size_t i;
+
+   operations = 0;
+
+   for(round = 0; round < workload->rounds; round++)
+   {
+      size_t requested = 0;
+
+      for(i = 0; i < LIVE; i++)
+      {
+         size_t size = workload->min_size +
+                       rand() % (workload->max_size - workload->min_size + 1);
+         double start = now();
+
+         blocks[i] = kalloc_heap_aligned(size, workload->alignment, heap);
+         latencies[operations] = now() - start;
+         elapsed += latencies[operations++];
+
+         if(blocks[i] == NULL)
+         {
+            printf("%s: allocation failed\n", workload->name);
+            exit(1);
+         }
+         requested += size;
+      }
+      overhead += (double)(heap->end_address - heap->start_address) /
+                  requested;
+
+      for(i = 0; i < LIVE; i++) {
+         order[i] = (workload->order == FREE_LIFO) ? LIVE - 1 - i : i;
+      }
+      if(workload->order == FREE_RANDOM)
+      {
+         for(i = LIVE - 1; i > 0; i--)
+         {
+            size_t j = rand() % (i + 1);
+            size_t tmp = order[i];
+            order[i] = order[j];
+            order[j] = tmp;
+         }
+      }
+
+      for(i = 0; i < LIVE; i++)
+      {
+         double start;
+
+         if(i == LIVE / 2) {
+            fragmented += fragmentation(heap);
+         }
+
+         start = now();
+         kfree_heap(blocks[order[i]], heap);
+         latencies[operations] = now() - start;
+         elapsed += latencies[operations++];
+      }
+   }
+
+   report(workload->name, elapsed, fragmented / workload->rounds,
+          overhead / workload->rounds);
+}
+
+// times allocations that grow a small heap all the way to its max_address,
+// until an allocation fails
+void run_growth(void *space)
+{
+   struct heap *heap = heap_create(space, space + GROWTH_INITIAL,
+                                   space + SPACE_SIZE);
+   size_t requested = 0;
+   double elapsed = 0;
+
+   operations = 0;
+
+   while(operations < 2 * LIVE * ROUNDS)
+   {
+      double start = now();
+      void *p = kalloc_heap(GROWTH_SIZE, 0, heap);
+
+      latencies[operations] = now() - start;
+      elapsed += latencies[operations++];
+
+      if(p == NULL) {
+         break;
+      }
+      requested += GROWTH_SIZE;
+   }
+
+   // the overhead is against all of the space the heap could grow into
+   report("growth to max", elapsed, fragmentation(heap),
+          (double)(heap->max_address - heap->start_address) / requested);
+}
+
+int main(int argc, char **argv)
+{
+   void *space = malloc(SPACE_SIZE);
+   size_t i;
+
+   if(space == NULL)
+   {
+      printf("could not allocate the heap space\n");
+      return 1;
+   }
+
+   srand(1);
+
+   printf("%-20s %10s %8s %8s %8s %8s %8s\n", "workload", "ops/s", "p50 ns",
+          "p99 ns", "p999 ns", "frag", "overhead");
+
+   for(i = 0; i < sizeof(workloads) / sizeof(workloads[0]); i++) {
+      run(&workloads[i], space);
+   }
+   run_growth(space);
+
+   free(space);
+
+   return 0;
+}
@@ -0,0 +1,256 @@
+// A binary buddy allocator for page-granular allocations - implementation
+
+#include "buddy.h"
+
+#include "memset.h"
+
+// headers for local functions
+size_t buddy_pages(struct buddy_heap *buddy);
+void *buddy_page(size_t i, struct buddy_heap *buddy);
+void buddy_push(size_t i, u32int order, struct buddy_heap *buddy);
+void buddy_unlink(size_t i, u32int order, struct buddy_heap *buddy);
+void buddy_release(size_t i, u32int order, struct buddy_heap *buddy);
+void buddy_add_pages(size_t first, size_t last, struct buddy_heap *buddy);
+s8int buddy_grow(u32int order, struct buddy_heap *buddy) WARN_UNUSED;
+
+// returns the number of pages in use
+size_t buddy_pages(struct buddy_heap *buddy)
+{
+   return (buddy->end_address - buddy->base) / PAGE_SIZE;
+}
+
+// returns the address of page i
+void *buddy_page(size_t i, struct buddy_heap *buddy)
+{
+   return buddy->base + i * PAGE_SIZE;
+}
+
+// adds the block of the given order starting at page i to its free list
+void buddy_push(size_t i, u32int order, struct buddy_heap *buddy)
+{
+   struct buddy_block *block = buddy_page(i, buddy);
+
+   block->prev = NULL;
+   block->next = buddy->free[order];
+   if(block->next != NULL) {
+      block->next->prev = block;
+   }
+   buddy->free[order] = block;
+
+   buddy->map[i] = BUDDY_FREE | order;
+   buddy->free_pages += (size_t)1 << order;
+}
+
+// takes the block of the given order starting at page i off its free list
+void buddy_unlink(size_t i, u32int order, struct buddy_heap *buddy)
+{
+   struct buddy_block *block = buddy_page(i, buddy);
+
+   if(block->prev != NULL) {
+      block->prev->next = block->next;
+   }
+   else {
+      buddy->free[order] = block->next;
+   }
+   if(block->next != NULL) {
+      block->next->prev = block->prev;
+   }
+
+   buddy->map[i] = 0;
+   buddy->free_pages -= (size_t)1 << order;
+}
+
+// frees the block of the given order starting at page i, merging it with its
+// buddy for as long as the buddy is free and whole
+void buddy_release(size_t i, u32int order, struct buddy_heap *buddy)
+{
+   size_t pages = buddy_pages(buddy);
+
+   buddy->map[i] = 0;
+
+   while(order < BUDDY_MAX_ORDER)
+   {
+      size_t other = i ^ ((size_t)1 << order);
+
+      if(other + ((size_t)1 << order) > pages ||
+         buddy->map[other] != (BUDDY_FREE | order))
+      {
+         break;
+      }
+
+      buddy_unlink(other, order, buddy);
+      if(other < i) {
+         i = other;
+      }
+      order++;
+   }
+
+   buddy_push(i, order, buddy);
+}
+
+// frees the pages [first,last) as the largest aligned blocks that fit
+void buddy_add_pages(size_t first, size_t last, struct buddy_heap *buddy)
+{
+   while(first < last)
+   {
+      u32int order = 0;
+
+      while(order < BUDDY_MAX_ORDER &&
+            (first & ((size_t)1 << order)) == 0 &&
+            first + ((size_t)2 << order) <= last)
+      {
+         order++;
+      }
+
+      buddy_release(first, order, buddy);
+      first += (size_t)1 << order;
+   }
+}
+
+// grows the region so that a free block of the given order can exist
+// the region at least doubles, so that a run of growing requests does not
+// grow it every time
+// returns a negative value if the region is already at its maximum
+s8int buddy_grow(u32int order, struct buddy_heap *buddy)
+{
+   size_t pages = buddy_pages(buddy);
+   size_t max_pages = (buddy->max_address - buddy->base) / PAGE_SIZE;
+   size_t block = (size_t)1 << order;
+   size_t new_pages;
+
+   if(pages >= max_pages) {
+      return -1;
+   }
+
+   // a block of this order has to start at a multiple of its size
+   new_pages = ((pages + block - 1) & ~(block - 1)) + block;
+   if(new_pages < 2 * pages) {
+      new_pages = 2 * pages;
+   }
+   if(new_pages > max_pages) {
+      new_pages = max_pages;
+   }
+
+   buddy->end_address = buddy_page(new_pages, buddy);
+   memset(buddy->map + pages, 0, new_pages - pages);
+   buddy_add_pages(pages, new_pages, buddy);
+
+   return 0;
+}
+
+struct buddy_heap *buddy_create(void *start, void *end, void *max)
+{
+   struct buddy_heap *buddy = (struct buddy_heap *)start;
+   size_t map_size;
+   size_t max_pages;
+
+   // one map byte for every page up to max, rounded so that the pages start
+   // on a page boundary
+   map_size = (max - start) / PAGE_SIZE;
+   buddy->map = start + sizeof(struct buddy_heap);
+   buddy->base = (void *)(((size_t)buddy->map + map_size + PAGE_SIZE - 1) &
+                          PAGE_MASK);
+   if(buddy->base >= max) {
+      return NULL;
+   }
+
+   max_pages = (max - buddy->base) / PAGE_SIZE;
+   memset(buddy->free, 0, sizeof(buddy->free));
+   buddy->free_pages = 0;
+   buddy->max_address = buddy_page(max_pages, buddy);
+
+   // the initial pages are whatever whole pages fit before end
+   if(end < buddy->base) {
+      end = buddy->base;
+   }
+   if(end > buddy->max_address) {
+      end = buddy->max_address;
+   }
+   buddy->end_address = buddy_page((end - buddy->base) / PAGE_SIZE, buddy);
+
+   // the map is only cleared for pages in use; buddy_grow clears the rest as
+   // the region grows
+   memset(buddy->map, 0, buddy_pages(buddy));
+   buddy_add_pages(0, buddy_pages(buddy), buddy);
+
+   return buddy;
+}
+
+void *buddy_alloc(size_t size, struct buddy_heap *buddy)
+{
+   size_t pages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+   u32int order = 0;
+   u32int found;
+   size_t i;
+
+   // the smallest block that holds the request
+   while(((size_t)1 << order) < pages)
+   {
+      order++;
+      if(order > BUDDY_MAX_ORDER) {
+         return NULL;
+      }
+   }
+
+   // find the smallest free block at least that large, growing if there is
+   // none
+   while(1)
+   {
+      found = order;
+      while(found <= BUDDY_MAX_ORDER && buddy->free[found] == NULL) {
+         found++;
+      }
+      if(found <= BUDDY_MAX_ORDER) {
+         break;
+      }
+      if(buddy_grow(order, buddy) < 0) {
+         return NULL;
+      }
+   }
+
+   i = ((void *)buddy->free[found] - buddy->base) / PAGE_SIZE;
+   buddy_unlink(i, found, buddy);
+
+   // split it down, freeing the upper halves
+   while(found > order)
+   {
+      found--;
+      buddy_push(i + ((size_t)1 << found), found, buddy);
+   }
+
+   buddy->map[i] = BUDDY_ALLOCATED | order;
+
+   return buddy_page(i, buddy);
+}
+
+void buddy_free(void *p, struct buddy_heap *buddy)
+{
+   size_t i;
+
+   if(p < buddy->base || p >= buddy->end_address) {
+      return;
+   }
+
+   i = (p - buddy->base) / PAGE_SIZE;
+   if(buddy_page(i, buddy) != p || !(buddy->map[i] & BUDDY_ALLOCATED)) {
+      return;
+   }
+
+   buddy_release(i, buddy->map[i] & BUDDY_ORDER_MASK, buddy);
+}
+
+size_t buddy_block_size(void *p, struct buddy_heap *buddy)
+{
+   size_t i;
+
+   if(p < buddy->base || p >= buddy->end_address) {
+      return 0;
+   }
+
+   i = (p - buddy->base) / PAGE_SIZE;
+   if(buddy_page(i, buddy) != p || !(buddy->map[i] & BUDDY_ALLOCATED)) {
+      return 0;
+   }
+
+   return (size_t)PAGE_SIZE << (buddy->map[i] & BUDDY_ORDER_MASK);
+}
@@ -0,0 +1,64 @@
+// A binary buddy allocator for page-granular allocations
+
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include "common.h"
+
+// the buddy allocator manages whole pages of a region, in blocks of 2^order
+// pages that start at a multiple of their own size from the first page. A
+// request is rounded up to the next such block; splitting and coalescing only
+// ever pair a block with its buddy (the other half of its parent), so
+// allocating and freeing are O(log n) and never leave odd-sized leftovers
+//
+// the region layout is:
+// | buddy struct | page map | pages ... |
+// where the page map holds one byte per page that the region can grow to
+
+// the largest block is 2^BUDDY_MAX_ORDER pages
+#define BUDDY_MAX_ORDER 20
+
+// page map entries: the order of the block that starts at the page, and
+// whether it is free or allocated; pages inside a block are 0
+#define BUDDY_ORDER_MASK 0x1f
+#define BUDDY_FREE       0x80
+#define BUDDY_ALLOCATED  0x40
+
+// a free block, stored at the start of its first page
+struct buddy_block
+{
+   struct buddy_block *next;
+   struct buddy_block *prev;
+};
+
+// the main buddy allocator struct
+struct buddy_heap
+{
+   struct buddy_block *free[BUDDY_MAX_ORDER + 1]; // free blocks of each order
+   u8int *map;            // one entry per page
+   void *base;            // the first page
+   void *end_address;     // the end of the pages in use
+   void *max_address;     // the end of the pages the region can grow to
+   size_t free_pages;     // the number of pages in free blocks
+};
+
+// creates a buddy allocator over a region, as heap_create does
+// start is the start point, end is the end of the initial region, and max is
+// the maximum point to which the region can grow
+// returns NULL if the region cannot hold any pages
+struct buddy_heap *buddy_create(void *start, void *end, void *max);
+
+// allocates a page-aligned block of at least size bytes
+// the block is size rounded up to a power-of-two number of pages
+// returns NULL if there is no free block large enough, even after growing
+void *buddy_alloc(size_t size, struct buddy_heap *buddy);
+
+// releases a block allocated with buddy_alloc, coalescing it with its buddy
+// as far as possible
+void buddy_free(void *p, struct buddy_heap *buddy);
+
+// returns the size in bytes of the block at p, or 0 if p does not start an
+// allocated block
+size_t buddy_block_size(void *p, struct buddy_heap *buddy);
+
+#endif // BUDDY_H
@@ -8,6 +8,8 @@
 
 // standard sizes
 // for x86
+typedef unsigned long long u64int;
+typedef          long long s64int;
 typedef unsigned int   u32int;
 typedef          int   s32int;
 typedef unsigned short u16int;
@@ -0,0 +1,410 @@
+// The free list: holes sorted by size - implementation
+
+#include "free_list.h"
+
+#include "memcpy.h"
+
+// the vector scans work on 64-bit sizes
+#if defined(__x86_64__)
+#define FREE_LIST_X86
+#include <immintrin.h>
+#endif
+
+// headers for local functions
+size_t free_list_scan_words(const size_t *sizes, size_t n, size_t size);
+size_t free_list_scan_sse2(const size_t *sizes, size_t n, size_t size);
+size_t free_list_scan_avx2(const size_t *sizes, size_t n, size_t size);
+size_t free_list_scan(const size_t *sizes, size_t n, size_t size);
+size_t free_list_slot(struct header *hole,
+                      size_t size,
+                      struct free_list *list);
+u8int free_list_before(size_t i, struct header *hole, struct free_list *list);
+size_t free_list_front(struct free_list *list);
+void free_list_compact(struct free_list *list);
+
+// the variant searches use; NULL until the first search picks one
+// a scan returns how many of the n sorted sizes are smaller than size
+size_t (*free_list_scanner)(const size_t *, size_t, size_t) = NULL;
+
+// scans one size at a time
+size_t free_list_scan_words(const size_t *sizes, size_t n, size_t size)
+{
+   size_t i = 0;
+
+   while(i < n && sizes[i] < size) {
+      i++;
+   }
+
+   return i;
+}
+
+#ifdef FREE_LIST_X86
+
+// the vector scans subtract size from each of the sizes, and a result with the
+// sign bit set means that the size was smaller; that only holds for sizes
+// below 2^63, so larger ones are scanned one at a time (no hole is that large
+// in practice)
+#define FREE_LIST_VECTOR_LIMIT ((size_t)1 << 63)
+
+// scans two sizes at a time
+__attribute__((target("sse2")))
+size_t free_list_scan_sse2(const size_t *sizes, size_t n, size_t size)
+{
+   __m128i key = _mm_set1_epi64x(size);
+   size_t i = 0;
+   u32int mask;
+
+   if(size >= FREE_LIST_VECTOR_LIMIT) {
+      return free_list_scan_words(sizes, n, size);
+   }
+
+   for(; i + 2 <= n; i += 2)
+   {
+      mask = _mm_movemask_pd(_mm_castsi128_pd(
+                _mm_sub_epi64(_mm_loadu_si128((const __m128i *)&sizes[i]),
+                              key)));
+
+      // the sizes are sorted, so the first one that is not smaller ends it
+      if(mask != 0x3) {
+         return i + __builtin_ctz(~mask);
+      }
+   }
+
+   return i + free_list_scan_words(&sizes[i], n - i, size);
+}
+
+// scans four sizes at a time
+__attribute__((target("avx2")))
+size_t free_list_scan_avx2(const size_t *sizes, size_t n, size_t size)
+{
+   __m256i key = _mm256_set1_epi64x(size);
+   size_t i = 0;
+   u32int mask;
+
+   if(size >= FREE_LIST_VECTOR_LIMIT) {
+      return free_list_scan_words(sizes, n, size);
+   }
+
+   for(; i + 4 <= n; i += 4)
+   {
+      mask = _mm256_movemask_pd(_mm256_castsi256_pd(
+                _mm256_sub_epi64(
+                   _mm256_loadu_si256((const __m256i *)&sizes[i]), key)));
+
+      // the sizes are sorted, so the first one that is not smaller ends it
+      if(mask != 0xf) {
+         return i + __builtin_ctz(~mask);
+      }
+   }
+
+   return i + free_list_scan_words(&sizes[i], n - i, size);
+}
+
+#else
+
+// without 64-bit x86 vector registers, the sizes are scanned one at a time
+size_t free_list_scan_sse2(const size_t *sizes, size_t n, size_t size)
+{
+   return free_list_scan_words(sizes, n, size);
+}
+
+size_t free_list_scan_avx2(const size_t *sizes, size_t n, size_t size)
+{
+   return free_list_scan_words(sizes, n, size);
+}
+
+#endif // FREE_LIST_X86
+
+// returns how many of the n sorted sizes are smaller than size
+size_t free_list_scan(const size_t *sizes, size_t n, size_t size)
+{
+   // several threads may race to pick the variant, but they all pick the same
+   if(free_list_scanner == NULL) {
+      free_list_use(memset_best());
+   }
+
+   return free_list_scanner(sizes, n, size);
+}
+
+// returns the index that a hole of the given size goes at, after every entry
+// that comes before it
+size_t free_list_slot(struct header *hole,
+                      size_t size,
+                      struct free_list *list)
+{
+   size_t low = free_list_lower_bound(size, list);
+   size_t high = low;
+   size_t step = 1;
+
+   // the holes of the same size are ordered by address, and there are
+   // usually only a few of them; step past them in growing steps, and then
+   // binary search the last step for the hole's place
+   while(high < list->entries && list->sizes[high] == size &&
+         free_list_before(high, hole, list))
+   {
+      low = high + 1;
+      high = low + step;
+      step *= 2;
+   }
+   if(high > list->entries) {
+      high = list->entries;
+   }
+
+   while(low < high)
+   {
+      size_t middle = low + (high - low) / 2;
+
+      if(list->sizes[middle] == size &&
+         free_list_before(middle, hole, list)) {
+         low = middle + 1;
+      }
+      else {
+         high = middle;
+      }
+   }
+
+   return low;
+}
+
+// returns 1 if entry i comes before the given hole, which has the same size
+// a vacant entry stands in for the nearest entry of that size on its left, or
+// comes before all of them if there is none; that keeps the entries in order
+// whichever holes are removed
+u8int free_list_before(size_t i, struct header *hole, struct free_list *list)
+{
+   size_t size = list->sizes[i];
+
+   while(list->holes[i] == NULL)
+   {
+      if(i == 0 || list->sizes[i - 1] != size) {
+         return 1;
+      }
+      i--;
+   }
+
+   return list->holes[i] < hole;
+}
+
+// returns the number of free entries in front of the holes
+size_t free_list_front(struct free_list *list)
+{
+   return list->sizes - (size_t *)list->storage;
+}
+
+// squeezes the vacant entries out of the list, in one pass
+void free_list_compact(struct free_list *list)
+{
+   size_t kept = 0;
+   size_t i;
+
+   for(i = 0; i < list->entries; i++)
+   {
+      if(list->holes[i] != NULL)
+      {
+         list->sizes[kept] = list->sizes[i];
+         list->holes[kept] = list->holes[i];
+         kept++;
+      }
+   }
+
+   list->entries = kept;
+   list->vacant = FREE_LIST_NONE;
+}
+
+struct free_list free_list_place(void *addr, size_t max_size)
+{
+   struct free_list list;
+
+   // an empty list starts in the middle, to grow both ways
+   list.storage = addr;
+   list.sizes = (size_t *)addr + max_size / 2;
+   list.holes = (struct header **)((size_t *)addr + max_size) + max_size / 2;
+   list.entries = 0;
+   list.vacant = FREE_LIST_NONE;
+   list.size = 0;
+   list.max_size = max_size;
+
+   return list;
+}
+
+void free_list_relocate(void *addr, size_t max_size, struct free_list *list)
+{
+   struct free_list moved = free_list_place(addr, max_size);
+   size_t front = (max_size - list->size) / 2;
+
+   free_list_compact(list);
+
+   moved.sizes = (size_t *)addr + front;
+   moved.holes = (struct header **)((size_t *)addr + max_size) + front;
+   memcpy(moved.sizes, list->sizes, list->size * sizeof(size_t));
+   memcpy(moved.holes, list->holes, list->size * sizeof(struct header *));
+   moved.entries = list->size;
+   moved.size = list->size;
+   *list = moved;
+}
+
+s8int free_list_insert(struct header *hole,
+                       size_t size,
+                       struct free_list *list)
+{
+   size_t vacant = list->vacant;
+   size_t i;
+
+   if(list->size >= list->max_size) {
+      return -1;
+   }
+
+   // with no free entries on either side, the vacant ones make room
+   if(list->entries == list->max_size) {
+      free_list_compact(list);
+      vacant = FREE_LIST_NONE;
+   }
+
+   i = free_list_slot(hole, size, list);
+
+   // fill a vacant entry next to the slot, or else the one last vacated
+   if(i > 0 && list->holes[i - 1] == NULL) {
+      vacant = i - 1;
+   }
+   else if(i < list->entries && list->holes[i] == NULL) {
+      vacant = i;
+   }
+   else if(vacant != FREE_LIST_NONE && list->holes[vacant] != NULL) {
+      vacant = FREE_LIST_NONE;
+   }
+
+   if(vacant != FREE_LIST_NONE)
+   {
+      // shift the entries between the vacant entry and the slot into the
+      // vacant entry, which frees the slot
+      if(vacant < i)
+      {
+         i--;
+         memmove(&list->sizes[vacant], &list->sizes[vacant + 1],
+                 (i - vacant) * sizeof(size_t));
+         memmove(&list->holes[vacant], &list->holes[vacant + 1],
+                 (i - vacant) * sizeof(struct header *));
+      }
+      else
+      {
+         memmove(&list->sizes[i + 1], &list->sizes[i],
+                 (vacant - i) * sizeof(size_t));
+         memmove(&list->holes[i + 1], &list->holes[i],
+                 (vacant - i) * sizeof(struct header *));
+      }
+
+      if(vacant == list->vacant) {
+         list->vacant = FREE_LIST_NONE;
+      }
+   }
+   else
+   {
+      size_t front = free_list_front(list);
+      size_t back = list->max_size - front - list->entries;
+
+      if(front > 0 && (back == 0 || i < list->entries - i))
+      {
+         // shift the entries before the slot down into the free entries in
+         // front
+         memmove(list->sizes - 1, list->sizes, i * sizeof(size_t));
+         memmove(list->holes - 1, list->holes, i * sizeof(struct header *));
+         list->sizes--;
+         list->holes--;
+      }
+      else
+      {
+         memmove(&list->sizes[i + 1], &list->sizes[i],
+                 (list->entries - i) * sizeof(size_t));
+         memmove(&list->holes[i + 1], &list->holes[i],
+                 (list->entries - i) * sizeof(struct header *));
+      }
+
+      // either way, the entries from the slot on are one further along
+      if(list->vacant != FREE_LIST_NONE && list->vacant >= i) {
+         list->vacant++;
+      }
+      list->entries++;
+   }
+
+   list->sizes[i] = size;
+   list->holes[i] = hole;
+   list->size++;
+
+   return 0;
+}
+
+size_t free_list_lower_bound(size_t size, struct free_list *list)
+{
+   size_t low = 0;
+   size_t high = list->entries;
+
+   while(high - low > FREE_LIST_SCAN)
+   {
+      size_t middle = low + (high - low) / 2;
+
+      if(list->sizes[middle] < size) {
+         low = middle + 1;
+      }
+      else {
+         high = middle;
+      }
+   }
+
+   return low + free_list_scan(&list->sizes[low], high - low, size);
+}
+
+size_t free_list_search(struct header *hole,
+                        size_t size,
+                        struct free_list *list)
+{
+   size_t i = free_list_slot(hole, size, list);
+
+   if(i < list->entries && list->holes[i] == hole) {
+      return i;
+   }
+
+   return list->entries;
+}
+
+void free_list_remove(size_t i, struct free_list *list)
+{
+   if(i >= list->entries || list->holes[i] == NULL) {
+      return;
+   }
+
+   list->holes[i] = NULL;
+   list->vacant = i;
+   list->size--;
+
+   // searches step over the vacant entries, so they are squeezed out before
+   // they are a large share of the list; that takes one pass per quarter of
+   // the list removed, so a removal is O(1) amortized
+   if((list->entries - list->size) * 4 > list->entries) {
+      free_list_compact(list);
+   }
+}
+
+u32int free_list_use(u32int variant)
+{
+   u32int best = memset_best();
+
+   if(variant > best) {
+      variant = best;
+   }
+
+   switch(variant)
+   {
+      case MEMSET_BYTES:
+      case MEMSET_WORDS:
+         free_list_scanner = &free_list_scan_words;
+         break;
+      case MEMSET_SSE2:
+         free_list_scanner = &free_list_scan_sse2;
+         break;
+      default:
+         free_list_scanner = &free_list_scan_avx2;
+         break;
+   }
+
+   return variant;
+}
@@ -0,0 +1,90 @@
+// The free list: holes sorted by size, with the sizes packed apart from them
+
+#ifndef FREE_LIST_H
+#define FREE_LIST_H
+
+#include "common.h"
+#include "memset.h"
+
+// the list is a structure of arrays: the sizes of the holes are packed next to
+// each other in one array, and the holes themselves are at the same indexes in
+// another. Searches read the sizes, and the hole addresses to order holes of
+// the same size, so finding a hole does not touch any hole header
+// holes are ordered by size, and then by address
+//
+// the holes sit in the middle of the storage, with free entries on both sides,
+// so that an insert only shifts the entries on the side of it that has fewer
+// of them. A removal does not shift anything: it leaves the hole's entry in
+// place, marked vacant with a NULL hole, and keeps its size so that the sizes
+// stay sorted; searches step over vacant entries. An insert fills a vacant
+// entry next to its own place, or else the one last vacated, moving only the
+// entries between the two (the holes an allocation or free removes and the
+// one it inserts next tend to be close in size). Once a quarter of the
+// entries are vacant, they are all squeezed out in one pass
+//
+// the sizes are scanned with the widest compares the CPU supports, using the
+// same MEMSET_* variants as memset; the variant is picked on the first search,
+// and can be overridden with free_list_use
+
+struct header;
+
+// the main free list struct
+struct free_list
+{
+   void *storage;         // where the list is stored
+   size_t *sizes;         // the size of each entry, somewhere in the storage
+   struct header **holes; // the entries' holes, in the same order
+   size_t entries;        // the number of entries, including vacant ones
+   size_t vacant;         // the entry last vacated, or FREE_LIST_NONE
+   size_t size;           // the number of holes in the list
+   size_t max_size;       // the number of holes there is room for
+};
+
+// the vacant index when no entry has been vacated since the list last changed
+// shape
+#define FREE_LIST_NONE ((size_t)-1)
+
+// the storage the list needs for each hole
+#define FREE_LIST_ENTRY_SIZE (sizeof(size_t) + sizeof(struct header *))
+
+// searches halve the range of sizes until it is this small, and then scan it
+#define FREE_LIST_SCAN 32
+
+// returns an empty list with room for max_size holes, stored at addr
+// addr should point to FREE_LIST_ENTRY_SIZE * max_size bytes
+struct free_list free_list_place(void *addr, size_t max_size);
+
+// moves a list into new storage at addr, with room for max_size holes;
+// max_size must be at least the number of holes in the list, and the new
+// storage must not overlap the old. The old storage is no longer used
+// afterwards
+void free_list_relocate(void *addr, size_t max_size, struct free_list *list);
+
+// adds a hole of the given size to the list
+// returns a negative value if the list is full, 0 on success
+s8int free_list_insert(struct header *hole,
+                       size_t size,
+                       struct free_list *list);
+
+// returns the index of the first entry of at least the given size, or
+// list->entries if there is none
+// the entry may be vacant (its hole is NULL); the entries after it are in
+// order of size, and vacant ones among them are to be skipped
+size_t free_list_lower_bound(size_t size, struct free_list *list);
+
+// returns the index of a hole of the given size, or list->entries if it is not
+// in the list
+size_t free_list_search(struct header *hole,
+                        size_t size,
+                        struct free_list *list);
+
+// removes the hole at index i from the list, leaving its entry vacant
+// nothing is removed if i is not the index of a hole
+void free_list_remove(size_t i, struct free_list *list);
+
+// makes searches use the given MEMSET_* variant, or the fastest supported one
+// if the CPU does not support it
+// returns the variant now in use
+u32int free_list_use(u32int variant);
+
+#endif // FREE_LIST_H
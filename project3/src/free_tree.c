@@ -0,0 +1,419 @@
+// A red-black tree of free holes - implementation
+
+#include "free_tree.h"
+
+#define FREE_TREE_RED   0
+#define FREE_TREE_BLACK 1
+
+// headers for local functions
+struct free_tree_node *free_tree_parent(struct free_tree_node *node);
+u8int free_tree_color(struct free_tree_node *node);
+void free_tree_set_parent(struct free_tree_node *node,
+                          struct free_tree_node *parent);
+void free_tree_set_color(struct free_tree_node *node, u8int color);
+s8int free_tree_compare(struct free_tree_node *a, struct free_tree_node *b);
+void free_tree_rotate_left(struct free_tree_node *node,
+                           struct free_tree *tree);
+void free_tree_rotate_right(struct free_tree_node *node,
+                            struct free_tree *tree);
+void free_tree_transplant(struct free_tree_node *old,
+                          struct free_tree_node *new,
+                          struct free_tree *tree);
+struct free_tree_node *free_tree_minimum(struct free_tree_node *node);
+
+// returns the parent of node
+struct free_tree_node *free_tree_parent(struct free_tree_node *node)
+{
+   return (struct free_tree_node *)(node->parent_color & ~(size_t)1);
+}
+
+// returns the colour of node; empty leaves are black
+u8int free_tree_color(struct free_tree_node *node)
+{
+   if(node == NULL) {
+      return FREE_TREE_BLACK;
+   }
+
+   return node->parent_color & 1;
+}
+
+// sets the parent of node, keeping its colour
+void free_tree_set_parent(struct free_tree_node *node,
+                          struct free_tree_node *parent)
+{
+   node->parent_color = (size_t)parent | (node->parent_color & 1);
+}
+
+// sets the colour of node, keeping its parent
+void free_tree_set_color(struct free_tree_node *node, u8int color)
+{
+   node->parent_color = (node->parent_color & ~(size_t)1) | color;
+}
+
+// returns -1 if a orders before b, 0 if they are the same node, 1 otherwise
+// nodes are ordered by key and then by address
+s8int free_tree_compare(struct free_tree_node *a, struct free_tree_node *b)
+{
+   if(a->key != b->key) {
+      return (a->key < b->key) ? -1 : 1;
+   }
+   if(a != b) {
+      return (a < b) ? -1 : 1;
+   }
+
+   return 0;
+}
+
+// rotates the subtree at node to the left; node's right child takes its place
+void free_tree_rotate_left(struct free_tree_node *node,
+                           struct free_tree *tree)
+{
+   struct free_tree_node *pivot = node->right;
+
+   node->right = pivot->left;
+   if(pivot->left != NULL) {
+      free_tree_set_parent(pivot->left, node);
+   }
+
+   free_tree_transplant(node, pivot, tree);
+
+   pivot->left = node;
+   free_tree_set_parent(node, pivot);
+}
+
+// rotates the subtree at node to the right; node's left child takes its place
+void free_tree_rotate_right(struct free_tree_node *node,
+                            struct free_tree *tree)
+{
+   struct free_tree_node *pivot = node->left;
+
+   node->left = pivot->right;
+   if(pivot->right != NULL) {
+      free_tree_set_parent(pivot->right, node);
+   }
+
+   free_tree_transplant(node, pivot, tree);
+
+   pivot->right = node;
+   free_tree_set_parent(node, pivot);
+}
+
+// puts new in the place of old in old's parent (new may be NULL)
+// the children of old are not touched
+void free_tree_transplant(struct free_tree_node *old,
+                          struct free_tree_node *new,
+                          struct free_tree *tree)
+{
+   struct free_tree_node *parent = free_tree_parent(old);
+
+   if(parent == NULL) {
+      tree->root = new;
+   }
+   else if(old == parent->left) {
+      parent->left = new;
+   }
+   else {
+      parent->right = new;
+   }
+
+   if(new != NULL) {
+      free_tree_set_parent(new, parent);
+   }
+}
+
+// returns the leftmost node of the subtree at node
+struct free_tree_node *free_tree_minimum(struct free_tree_node *node)
+{
+   while(node->left != NULL) {
+      node = node->left;
+   }
+
+   return node;
+}
+
+struct free_tree free_tree_create(void)
+{
+   struct free_tree tree;
+
+   tree.root = NULL;
+   tree.size = 0;
+
+   return tree;
+}
+
+void free_tree_insert(struct free_tree_node *node,
+                      size_t key,
+                      struct free_tree *tree)
+{
+   struct free_tree_node *parent = NULL;
+   struct free_tree_node **link = &tree->root;
+
+   node->key = key;
+   node->left = NULL;
+   node->right = NULL;
+
+   // ordinary binary search tree insertion
+   while(*link != NULL)
+   {
+      parent = *link;
+      if(free_tree_compare(node, parent) < 0) {
+         link = &parent->left;
+      }
+      else {
+         link = &parent->right;
+      }
+   }
+
+   // new nodes start out red
+   node->parent_color = (size_t)parent | FREE_TREE_RED;
+   *link = node;
+   tree->size++;
+
+   // restore the red-black properties: walk up while there are two reds in a
+   // row
+   while((parent = free_tree_parent(node)) != NULL &&
+         free_tree_color(parent) == FREE_TREE_RED)
+   {
+      // the parent is red, so it is not the root, and the grandparent exists
+      struct free_tree_node *grandparent = free_tree_parent(parent);
+
+      if(parent == grandparent->left)
+      {
+         struct free_tree_node *uncle = grandparent->right;
+
+         if(free_tree_color(uncle) == FREE_TREE_RED)
+         {
+            // recolour and continue from the grandparent
+            free_tree_set_color(parent, FREE_TREE_BLACK);
+            free_tree_set_color(uncle, FREE_TREE_BLACK);
+            free_tree_set_color(grandparent, FREE_TREE_RED);
+            node = grandparent;
+         }
+         else
+         {
+            if(node == parent->right)
+            {
+               // rotate into the outer case
+               node = parent;
+               free_tree_rotate_left(node, tree);
+               parent = free_tree_parent(node);
+            }
+
+            free_tree_set_color(parent, FREE_TREE_BLACK);
+            free_tree_set_color(grandparent, FREE_TREE_RED);
+            free_tree_rotate_right(grandparent, tree);
+         }
+      }
+      else
+      {
+         struct free_tree_node *uncle = grandparent->left;
+
+         if(free_tree_color(uncle) == FREE_TREE_RED)
+         {
+            free_tree_set_color(parent, FREE_TREE_BLACK);
+            free_tree_set_color(uncle, FREE_TREE_BLACK);
+            free_tree_set_color(grandparent, FREE_TREE_RED);
+            node = grandparent;
+         }
+         else
+         {
+            if(node == parent->left)
+            {
+               node = parent;
+               free_tree_rotate_right(node, tree);
+               parent = free_tree_parent(node);
+            }
+
+            free_tree_set_color(parent, FREE_TREE_BLACK);
+            free_tree_set_color(grandparent, FREE_TREE_RED);
+            free_tree_rotate_left(grandparent, tree);
+         }
+      }
+   }
+
+   free_tree_set_color(tree->root, FREE_TREE_BLACK);
+}
+
+void free_tree_remove(struct free_tree_node *node, struct free_tree *tree)
+{
+   // child is the node that moves into the removed position (may be NULL), and
+   // parent is its parent after the move
+   struct free_tree_node *child;
+   struct free_tree_node *parent;
+   u8int removed_color = free_tree_color(node);
+
+   if(node->left == NULL)
+   {
+      child = node->right;
+      parent = free_tree_parent(node);
+      free_tree_transplant(node, node->right, tree);
+   }
+   else if(node->right == NULL)
+   {
+      child = node->left;
+      parent = free_tree_parent(node);
+      free_tree_transplant(node, node->left, tree);
+   }
+   else
+   {
+      // two children - the in-order successor takes the node's place
+      struct free_tree_node *successor = free_tree_minimum(node->right);
+
+      removed_color = free_tree_color(successor);
+      child = successor->right;
+
+      if(free_tree_parent(successor) == node)
+      {
+         parent = successor;
+      }
+      else
+      {
+         parent = free_tree_parent(successor);
+         free_tree_transplant(successor, successor->right, tree);
+         successor->right = node->right;
+         free_tree_set_parent(successor->right, successor);
+      }
+
+      free_tree_transplant(node, successor, tree);
+      successor->left = node->left;
+      free_tree_set_parent(successor->left, successor);
+      free_tree_set_color(successor, free_tree_color(node));
+   }
+
+   tree->size--;
+
+   if(removed_color == FREE_TREE_RED) {
+      // removing a red node does not change any black heights
+      return;
+   }
+
+   // a black node was removed: child carries an extra black that has to be
+   // pushed up the tree or absorbed by a rotation
+   while(child != tree->root && free_tree_color(child) == FREE_TREE_BLACK)
+   {
+      if(child == parent->left)
+      {
+         struct free_tree_node *sibling = parent->right;
+
+         if(free_tree_color(sibling) == FREE_TREE_RED)
+         {
+            free_tree_set_color(sibling, FREE_TREE_BLACK);
+            free_tree_set_color(parent, FREE_TREE_RED);
+            free_tree_rotate_left(parent, tree);
+            sibling = parent->right;
+         }
+
+         if(free_tree_color(sibling->left) == FREE_TREE_BLACK &&
+            free_tree_color(sibling->right) == FREE_TREE_BLACK)
+         {
+            free_tree_set_color(sibling, FREE_TREE_RED);
+            child = parent;
+            parent = free_tree_parent(child);
+         }
+         else
+         {
+            if(free_tree_color(sibling->right) == FREE_TREE_BLACK)
+            {
+               free_tree_set_color(sibling->left, FREE_TREE_BLACK);
+               free_tree_set_color(sibling, FREE_TREE_RED);
+               free_tree_rotate_right(sibling, tree);
+               sibling = parent->right;
+            }
+
+            free_tree_set_color(sibling, free_tree_color(parent));
+            free_tree_set_color(parent, FREE_TREE_BLACK);
+            free_tree_set_color(sibling->right, FREE_TREE_BLACK);
+            free_tree_rotate_left(parent, tree);
+            child = tree->root;
+         }
+      }
+      else
+      {
+         struct free_tree_node *sibling = parent->left;
+
+         if(free_tree_color(sibling) == FREE_TREE_RED)
+         {
+            free_tree_set_color(sibling, FREE_TREE_BLACK);
+            free_tree_set_color(parent, FREE_TREE_RED);
+            free_tree_rotate_right(parent, tree);
+            sibling = parent->left;
+         }
+
+         if(free_tree_color(sibling->left) == FREE_TREE_BLACK &&
+            free_tree_color(sibling->right) == FREE_TREE_BLACK)
+         {
+            free_tree_set_color(sibling, FREE_TREE_RED);
+            child = parent;
+            parent = free_tree_parent(child);
+         }
+         else
+         {
+            if(free_tree_color(sibling->left) == FREE_TREE_BLACK)
+            {
+               free_tree_set_color(sibling->right, FREE_TREE_BLACK);
+               free_tree_set_color(sibling, FREE_TREE_RED);
+               free_tree_rotate_left(sibling, tree);
+               sibling = parent->left;
+            }
+
+            free_tree_set_color(sibling, free_tree_color(parent));
+            free_tree_set_color(parent, FREE_TREE_BLACK);
+            free_tree_set_color(sibling->left, FREE_TREE_BLACK);
+            free_tree_rotate_right(parent, tree);
+            child = tree->root;
+         }
+      }
+   }
+
+   if(child != NULL) {
+      free_tree_set_color(child, FREE_TREE_BLACK);
+   }
+}
+
+struct free_tree_node *free_tree_lower_bound(size_t key,
+                                             struct free_tree *tree)
+{
+   struct free_tree_node *node = tree->root;
+   struct free_tree_node *best = NULL;
+
+   // keep going left while the key fits, to find the first fitting node
+   while(node != NULL)
+   {
+      if(node->key >= key)
+      {
+         best = node;
+         node = node->left;
+      }
+      else
+      {
+         node = node->right;
+      }
+   }
+
+   return best;
+}
+
+struct free_tree_node *free_tree_first(struct free_tree *tree)
+{
+   if(tree->root == NULL) {
+      return NULL;
+   }
+
+   return free_tree_minimum(tree->root);
+}
+
+struct free_tree_node *free_tree_next(struct free_tree_node *node)
+{
+   struct free_tree_node *parent;
+
+   if(node->right != NULL) {
+      return free_tree_minimum(node->right);
+   }
+
+   // climb until we come up from a left subtree
+   while((parent = free_tree_parent(node)) != NULL && node == parent->right) {
+      node = parent;
+   }
+
+   return parent;
+}
@@ -0,0 +1,54 @@
+// A red-black tree of free holes, keyed on hole size
+
+#ifndef FREE_TREE_H
+#define FREE_TREE_H
+
+#include "common.h"
+
+// the tree is intrusive: each node lives inside the body of the hole that it
+// indexes, so the tree itself needs no memory beyond its root
+// nodes are ordered by key, and then by address, so that equal-sized holes are
+// handed out lowest address first
+// nodes must be at least 2-byte aligned, since the colour is kept in the
+// lowest bit of the parent pointer
+
+// a node of the tree
+struct free_tree_node
+{
+   struct free_tree_node *left;
+   struct free_tree_node *right;
+   size_t parent_color; // pointer to the parent node, colour in the low bit
+   size_t key;          // the size of the hole
+};
+
+// the main free tree struct
+struct free_tree
+{
+   struct free_tree_node *root;
+   size_t size;                 // the number of nodes in the tree
+};
+
+// creates an empty tree
+struct free_tree free_tree_create(void);
+
+// adds a node with the given key to the tree
+void free_tree_insert(struct free_tree_node *node,
+                      size_t key,
+                      struct free_tree *tree);
+
+// removes a node from the tree
+// node must currently be in the tree
+void free_tree_remove(struct free_tree_node *node, struct free_tree *tree);
+
+// returns the node with the smallest key that is >= key (the lowest addressed
+// such node if there are several), or NULL if there is none
+struct free_tree_node *free_tree_lower_bound(size_t key,
+                                             struct free_tree *tree);
+
+// returns the node with the smallest key, or NULL if the tree is empty
+struct free_tree_node *free_tree_first(struct free_tree *tree);
+
+// returns the next node in order after node, or NULL if node is the last one
+struct free_tree_node *free_tree_next(struct free_tree_node *node);
+
+#endif // FREE_TREE_H
@@ -1,5 +1,8 @@
 CC = gcc
 #CC = clang
 #CC = icc
-CFLAGS = -g -Wall
+# memset and friends are built from plain loops, which the optimizer must not
+# turn back into calls to themselves
+CFLAGS = -g -Wall -fno-tree-loop-distribute-patterns
+LDFLAGS = -pthread
 
@@ -3,16 +3,64 @@
 #include "kheap.h"
 
 #include "common.h"
+#include "memset.h"
+#include "memcpy.h"
+#include "vm.h"
 
 // headers for local functions
 void *align(void *p);
-ssize_t find_smallest_hole(size_t size,
-                           u8int page_align,
-                           struct heap *heap)
-                           WARN_UNUSED;
-s8int header_less_than(void *a, void *b);
+struct header *find_smallest_hole(size_t size,
+                                  size_t alignment,
+                                  struct heap *heap)
+                                  WARN_UNUSED;
 s8int heap_resize(size_t new_size, struct heap *heap) WARN_UNUSED;
+void heap_decommit(void *end, struct heap *heap);
+size_t growth_step(size_t length, struct heap *heap);
+size_t commit_granularity(struct heap *heap);
+void *align_up(void *p, size_t alignment);
+size_t scavenge_hole(struct header *hole, size_t budget, struct heap *heap);
+u8int hole_purged(struct header *hole);
+u8int hole_backed(struct header *hole, struct heap *heap);
+void set_purged(struct header *hole);
+s8int heap_expand(size_t size, size_t alignment, struct heap *heap)
+                  WARN_UNUSED;
 void add_hole(void *start, void *end, struct heap *heap);
+struct header *write_chunk(void *start, size_t size, u8int allocated);
+struct footer *get_footer(struct header *header);
+size_t block_size(struct header *header);
+u8int block_allocated(struct header *header);
+u8int block_valid(struct header *header);
+void set_prev_allocated(struct header *header, u8int allocated);
+struct header *left_hole(struct header *header, struct heap *heap);
+size_t min_block_size(struct heap *heap);
+size_t block_granularity(struct heap *heap);
+size_t align_offset(struct header *hole, size_t alignment, struct heap *heap);
+void hole_insert(struct header *hole, struct heap *heap);
+void hole_remove(struct header *hole, struct heap *heap);
+struct free_tree_node *hole_node(struct header *hole);
+struct header *node_hole(struct free_tree_node *node);
+struct bin_links *hole_links(struct header *hole);
+size_t bin_index(size_t size);
+void bin_insert(struct header *hole, struct heap *heap);
+void bin_remove(struct header *hole, struct heap *heap);
+struct header *bin_find(size_t size, struct heap *heap);
+size_t request_block_size(size_t size, struct heap *heap);
+u8int resize_in_place(struct header *header, size_t new_size,
+                      struct heap *heap);
+s8int free_list_move(size_t capacity, struct heap *heap);
+s8int free_list_reserve(size_t holes, struct heap *heap);
+void free_list_trim(struct heap *heap);
+void mark_free(struct header *header);
+u8int hole_listed(struct header *hole, struct heap *heap);
+u8int beside_listed_hole(void *start, void *end, struct heap *heap);
+void release_range(void *hole_start, void *hole_end, struct heap *heap);
+void sort_by_address(void **ptrs, size_t n);
+
+// returns p rounded up to a multiple of alignment, a power of two
+void *align_up(void *p, size_t alignment)
+{
+   return (void *)(((size_t)p + alignment - 1) & ~(alignment - 1));
+}
 
 // returns an aligned pointer
 // if the address is not aligned, then the aligned address prior to the given
@@ -31,21 +79,378 @@ void *align(void *p)
    return u.pointer;
 }
 
-// less than function for comparing the sizes of memory chunks, using the
-// headers; a < b iff a's size is less than b's size
-// a and b should both be pointers to header structs
-s8int header_less_than(void *a, void *b)
+// returns the footer of the block/hole with the given header
+// with HEAP_COMPACT, only holes have footers
+struct footer *get_footer(struct header *header)
+{
+   return (struct footer *)((size_t)header + block_size(header) -
+                            sizeof(struct footer));
+}
+
+// returns the size of a block/hole, including its header and footer
+size_t block_size(struct header *header)
+{
+#ifdef HEAP_COMPACT
+   return header->size & ~(size_t)HEAP_SIZE_BITS;
+#else
+   return header->size;
+#endif
+}
+
+// returns 1 if the block is in use, 0 if it is a hole
+u8int block_allocated(struct header *header)
+{
+#ifdef HEAP_COMPACT
+   return header->size & HEAP_ALLOCATED;
+#else
+   return header->allocated;
+#endif
+}
+
+// returns 1 if the block's magic numbers are intact, or cannot be checked
+u8int block_valid(struct header *header)
+{
+#ifdef HEAP_COMPACT
+#ifdef HEAP_DEBUG
+   return header->magic == HEAP_MAGIC;
+#else
+   return 1;
+#endif
+#else
+   return header->magic == HEAP_MAGIC && get_footer(header)->magic == HEAP_MAGIC;
+#endif
+}
+
+// records whether the block to the left of this one is in use
+// only HEAP_COMPACT keeps track of this; otherwise, the left footer is used
+void set_prev_allocated(struct header *header, u8int allocated)
+{
+#ifdef HEAP_COMPACT
+   if(allocated) {
+      header->size |= HEAP_PREV_ALLOCATED;
+   }
+   else {
+      header->size &= ~(size_t)HEAP_PREV_ALLOCATED;
+   }
+#endif
+}
+
+// returns the hole to the left of a block, or NULL if the block to the left
+// is in use or the block is the first in the heap
+struct header *left_hole(struct header *header, struct heap *heap)
+{
+   struct footer *left_footer;
+
+   if((void *)header <= heap->start_address) {
+      return NULL;
+   }
+
+#ifdef HEAP_COMPACT
+   if(header->size & HEAP_PREV_ALLOCATED) {
+      return NULL;
+   }
+
+   left_footer = (void *)header - sizeof(struct footer);
+   return left_footer->header;
+#else
+   //check if the magic number matches, and the segment is a hole
+   left_footer = (void *)header - sizeof(struct footer);
+   if(left_footer->magic == HEAP_MAGIC && left_footer->header->allocated == 0) {
+      return left_footer->header;
+   }
+
+   return NULL;
+#endif
+}
+
+// returns the smallest size a block/hole can have in this heap
+// holes have to be able to hold their index entry when the heap keeps its
+// index inside the holes
+size_t min_block_size(struct heap *heap)
+{
+   size_t body = 0;
+
+   if(heap->flags & HEAP_FREE_TREE) {
+      body = sizeof(struct free_tree_node);
+   }
+   if((heap->flags & HEAP_SEGREGATED) && body < sizeof(struct bin_links)) {
+      body = sizeof(struct bin_links);
+   }
+
+   return sizeof(struct header) + body + sizeof(struct footer);
+}
+
+// returns the multiple that block sizes are rounded up to in this heap
+size_t block_granularity(struct heap *heap)
+{
+   if(heap->flags & HEAP_SEGREGATED) {
+      return HEAP_BIN_SPACING;
+   }
+
+#ifdef HEAP_COMPACT
+   // the low bits of the size hold flags
+   return HEAP_TREE_ALIGN;
+#else
+   if(heap->flags & HEAP_FREE_TREE) {
+      return HEAP_TREE_ALIGN;
+   }
+
+   return 1;
+#endif
+}
+
+// returns the tree node stored in the body of a hole
+struct free_tree_node *hole_node(struct header *hole)
+{
+   return (struct free_tree_node *)((size_t)hole + sizeof(struct header));
+}
+
+// returns the hole whose body holds the tree node
+struct header *node_hole(struct free_tree_node *node)
+{
+   return (struct header *)((size_t)node - sizeof(struct header));
+}
+
+// returns the bin links stored in the body of a hole
+struct bin_links *hole_links(struct header *hole)
+{
+   return (struct bin_links *)((size_t)hole + sizeof(struct header));
+}
+
+// returns the bin for holes of the given size, or HEAP_BIN_COUNT if holes of
+// that size belong in the main index
+size_t bin_index(size_t size)
+{
+   if(size >= HEAP_BIN_LIMIT) {
+      return HEAP_BIN_COUNT;
+   }
+
+   return size / HEAP_BIN_SPACING;
+}
+
+// pushes a hole onto the front of its bin
+void bin_insert(struct header *hole, struct heap *heap)
+{
+   size_t i = bin_index(block_size(hole));
+   struct heap_bin *bin = &heap->bins[i];
+   struct bin_links *links = hole_links(hole);
+
+   links->prev = NULL;
+   links->next = bin->head;
+   if(bin->head != NULL) {
+      hole_links(bin->head)->prev = hole;
+   }
+
+   bin->head = hole;
+   bin->holes++;
+   heap->bin_map |= (u64int)1 << i;
+}
+
+// unlinks a hole from its bin
+void bin_remove(struct header *hole, struct heap *heap)
+{
+   size_t i = bin_index(block_size(hole));
+   struct heap_bin *bin = &heap->bins[i];
+   struct bin_links *links = hole_links(hole);
+
+   if(links->prev != NULL) {
+      hole_links(links->prev)->next = links->next;
+   }
+   else {
+      bin->head = links->next;
+   }
+   if(links->next != NULL) {
+      hole_links(links->next)->prev = links->prev;
+   }
+
+   bin->holes--;
+   if(bin->head == NULL) {
+      heap->bin_map &= ~((u64int)1 << i);
+   }
+}
+
+// returns a hole from the first non-empty bin that fits a block of the given
+// size, or NULL if there is none
+// size must be a multiple of HEAP_BIN_SPACING, so that every hole in its own
+// bin fits it
+struct header *bin_find(size_t size, struct heap *heap)
+{
+   size_t i = bin_index(size);
+   u64int candidates;
+   size_t found;
+
+   if(i >= HEAP_BIN_COUNT) {
+      return NULL;
+   }
+
+   // the non-empty bins at or above the request's class
+   candidates = heap->bin_map & (~(u64int)0 << i);
+   if(candidates == 0)
+   {
+      heap->bins[i].misses++;
+      return NULL;
+   }
+
+   found = __builtin_ctzll(candidates);
+   if(found == i) {
+      heap->bins[i].hits++;
+   }
+   else {
+      heap->bins[i].misses++;
+      heap->bins[found].borrowed++;
+   }
+
+   return heap->bins[found].head;
+}
+
+// adds a hole to whichever index the heap uses
+// a hole that ends at the end of the heap becomes the heap's top
+void hole_insert(struct header *hole, struct heap *heap)
+{
+   if((void *)hole + block_size(hole) == heap->end_address) {
+      heap->top = hole;
+   }
+
+   if((heap->flags & HEAP_SEGREGATED) &&
+      bin_index(block_size(hole)) < HEAP_BIN_COUNT) {
+      bin_insert(hole, heap);
+   }
+   else if(heap->flags & HEAP_FREE_TREE) {
+      free_tree_insert(hole_node(hole), block_size(hole), &heap->free_tree);
+   }
+   else {
+      // whatever adds holes reserves room for them first (see
+      // free_list_reserve), so there is always room for this one
+      free_list_insert(hole, block_size(hole), &heap->free_list);
+   }
+}
+
+// removes a hole from whichever index the heap uses
+// the hole's size must not have changed since it was inserted
+void hole_remove(struct header *hole, struct heap *heap)
+{
+   if(hole == heap->top) {
+      heap->top = NULL;
+   }
+   if(hole == heap->scavenging) {
+      heap->scavenging = NULL;
+   }
+
+   if((heap->flags & HEAP_SEGREGATED) &&
+      bin_index(block_size(hole)) < HEAP_BIN_COUNT)
+   {
+      bin_remove(hole, heap);
+      return;
+   }
+
+   if(heap->flags & HEAP_FREE_TREE)
+   {
+      free_tree_remove(hole_node(hole), &heap->free_tree);
+      return;
+   }
+
+   // find the index of the hole in the free list
+   free_list_remove(free_list_search(hole, block_size(hole),
+                                     &heap->free_list),
+                    &heap->free_list);
+}
+
+// moves the free list into storage for the given number of entries; storage
+// larger than the initial storage is allocated from the heap
+// returns a negative value if the storage cannot be allocated, 0 on success
+s8int free_list_move(size_t capacity, struct heap *heap)
+{
+   struct free_list *list = &heap->free_list;
+   void *initial = (void *)heap + sizeof(struct heap);
+   void *old = list->storage;
+   void *storage = initial;
+
+   // the allocation and free below change the free list themselves; they
+   // must not try to move it again
+   heap->free_list_moving = 1;
+
+   if(capacity > HEAP_FREE_LIST_INITIAL) {
+      storage = kalloc_heap(capacity * FREE_LIST_ENTRY_SIZE, 0, heap);
+   }
+   else {
+      capacity = HEAP_FREE_LIST_INITIAL;
+   }
+
+   if(storage == NULL)
+   {
+      heap->free_list_moving = 0;
+      return -1;
+   }
+
+   // the allocation may have changed the list, so it is copied only now
+   free_list_relocate(storage, capacity, list);
+
+   if(old != initial) {
+      kfree_heap(old, heap);
+   }
+
+   heap->free_list_moving = 0;
+
+   return 0;
+}
+
+// makes sure the free list has room for the given number of new holes,
+// growing it if it is nearly full; one more entry is always kept free, for the
+// allocation that moves the list into larger storage
+// returns a negative value if there is no room and the list cannot grow
+s8int free_list_reserve(size_t holes, struct heap *heap)
 {
-   return (((struct header*)a)->size < ((struct header*)b)->size) ? 1 : 0;
+   struct free_list *list = &heap->free_list;
+
+   // the tree needs no storage, and a move in progress has reserved its room
+   if((heap->flags & HEAP_FREE_TREE) || heap->free_list_moving) {
+      return 0;
+   }
+
+   if(list->size + HEAP_FREE_LIST_SLACK <= list->max_size) {
+      return 0;
+   }
+
+   if(free_list_move(list->max_size * 2, heap) == 0) {
+      return 0;
+   }
+
+   // the list could not grow, but there may still be room for this
+   return (list->size + holes + 1 <= list->max_size) ? 0 : -1;
+}
+
+// shrinks the free list if it is less than a quarter full
+void free_list_trim(struct heap *heap)
+{
+   struct free_list *list = &heap->free_list;
+
+   if((heap->flags & HEAP_FREE_TREE) || heap->free_list_moving) {
+      return;
+   }
+
+   if(list->max_size > HEAP_FREE_LIST_INITIAL &&
+      list->size * 4 < list->max_size)
+   {
+      // if there is no room for the smaller storage, the list stays as it is
+      free_list_move(list->max_size / 2, heap);
+   }
+}
+
+struct heap *heap_create(void *start,
+                         void *end,
+                         void *max)
+{
+   return heap_create_flags(start, end, max, 0);
 }
 
 // creates a heap at the given start address, end address, and maximum growth
 // size
 // start, end, and max should all be page-aligned (but if they aren't, we just
 // waste some space)
-struct heap *heap_create(void *start,
-                         void *end,
-                         void *max)
+struct heap *heap_create_flags(void *start,
+                               void *end,
+                               void *max,
+                               u32int flags)
 {
    // in the real kernel, we would kmalloc here, where kmalloc is just a
    // placement implementation, since the heap does not exist yet!
@@ -53,26 +458,53 @@ struct heap *heap_create(void *start,
    // allocated
    //
    // the memory layout from start to end is as follows:
-   // | heap struct | free list | actual data |
+   // | heap struct | initial free list | actual data |
+   // once the free list outgrows its initial storage, it is moved into a
+   // block in the actual data
    //struct heap *heap = (struct heap*)kmalloc(sizeof(heap_t));
    struct heap *heap = (struct heap*)start;
+   size_t free_list_size = HEAP_FREE_LIST_INITIAL;
+
+   heap->flags = flags;
+   heap->free_list_moving = 0;
+   heap->top = NULL;
+   heap->committed = end;
+   heap->freed = 0;
+   heap->scavenging = NULL;
+   heap->growth_percent = HEAP_GROWTH_PERCENT;
+   heap->growth_min = HEAP_GROWTH_MIN;
+   heap->bin_map = 0;
+   // the bins are only touched with HEAP_SEGREGATED
+   if(flags & HEAP_SEGREGATED) {
+      memset(heap->bins, 0, sizeof(heap->bins));
+   }
+   spinlock_init(&heap->lock);
+
+   // the tree lives inside the holes, so it needs no storage of its own
+   heap->free_tree = free_tree_create();
+   if(flags & HEAP_FREE_TREE) {
+      free_list_size = 0;
+   }
 
    // create the free list
-   heap->free_list = sorted_array_place((void *)start +
-                                           sizeof(struct sorted_array),
-                                     HEAP_FREE_LIST_SIZE,
-                                     &header_less_than);
+   heap->free_list = free_list_place((void *)start + sizeof(struct heap),
+                                     free_list_size);
 
    // move the start address of the heap, to reflect where data can be place,
    // now that the free list is in the initial portion of the heap's memory
    // address space
-   start += sizeof(struct sorted_array) + sizeof(void *) * HEAP_FREE_LIST_SIZE;
+   start += sizeof(struct heap) + FREE_LIST_ENTRY_SIZE * free_list_size;
 
    // make sure the start address is page-aligned
    if(align(start) != start) {
       start = align(start) + PAGE_SIZE;
    }
 
+#ifdef HEAP_COMPACT
+   // hole sizes have to be a multiple of HEAP_TREE_ALIGN
+   end = (void *)((size_t)end & ~(size_t)HEAP_SIZE_BITS);
+#endif
+
    // write the avariables into the heap structure
    heap->start_address = start;
    heap->end_address = end;
@@ -84,6 +516,48 @@ struct heap *heap_create(void *start,
    return heap;
 }
 
+struct heap *heap_create_vm(size_t initial, size_t max, u32int flags)
+{
+   // the heap struct and the initial free list are at the start of the space,
+   // and are followed by at least a page for the data
+   size_t reserved = sizeof(struct heap) +
+                     FREE_LIST_ENTRY_SIZE * HEAP_FREE_LIST_INITIAL;
+   size_t page = (flags & HEAP_HUGE_PAGES) ? HEAP_HUGE_PAGE_SIZE : PAGE_SIZE;
+   void *space;
+
+   reserved = ((reserved + PAGE_SIZE - 1) & PAGE_MASK) + PAGE_SIZE;
+   if(initial < reserved) {
+      initial = reserved;
+   }
+   initial = (size_t)align_up((void *)initial, page);
+   max = (size_t)align_up((void *)max, page);
+   if(initial > max) {
+      return NULL;
+   }
+
+   space = vm_reserve(max, page);
+   if(space == NULL) {
+      return NULL;
+   }
+   if(flags & HEAP_HUGE_PAGES) {
+      vm_use_huge_pages(space, max);
+   }
+
+   if(vm_commit(space, initial, (flags & HEAP_POPULATE) != 0) < 0)
+   {
+      vm_release(space, max);
+      return NULL;
+   }
+
+   return heap_create_flags(space, space + initial, space + max,
+                            flags | HEAP_VM);
+}
+
+void heap_destroy_vm(struct heap *heap)
+{
+   vm_release(heap, heap->max_address - (void *)heap);
+}
+
 // expands or contracts the heap to the new_size
 // returns a negative value on error, 0 on success
 s8int heap_resize(size_t new_size, struct heap *heap)
@@ -97,25 +571,19 @@ s8int heap_resize(size_t new_size, struct heap *heap)
    if(new_size < heap->end_address - heap->start_address)
    {
       // contracting the heap
-      if (new_size&0x1000){
-         new_size &= 0x1000;
-         new_size += 0x1000;
-      }
 
       // we are going to naively assume that the heap is not being resized to
       // a value that is too small
 
-      // paging code would go here to free pages
-      // for now, just assume that in our flat memory space, memory is
+      // without HEAP_VM, just assume that in our flat memory space, memory is
       // available and does not need to be allocated or freed
+      if(heap->flags & HEAP_VM) {
+         heap_decommit(heap->start_address + new_size, heap);
+      }
    }
    else if(new_size > heap->end_address - heap->start_address)
    {
       // expanding the heap
-      if (new_size & 0xFFFFF000 != 0){
-         new_size &= 0xFFFFF000;
-         new_size += 0x1000;
-      }
 
       // make sure the new size is within the bounds
       if(heap->start_address + new_size > heap->max_address) {
@@ -123,9 +591,23 @@ s8int heap_resize(size_t new_size, struct heap *heap)
          return -1;
       }
 
-      // paging code would be here to allocate pages
-      // for now, just assume that in our flat memory space, memory is
-      // available and does not need to be allocated or freed
+      // pages that are still committed from before the heap last contracted
+      // are used again as they are
+      if((heap->flags & HEAP_VM) &&
+         heap->start_address + new_size > heap->committed)
+      {
+         void *committed = align_up(heap->start_address + new_size,
+                                    commit_granularity(heap));
+
+         if(committed > heap->max_address) {
+            committed = heap->max_address;
+         }
+         if(vm_commit(heap->committed, committed - heap->committed,
+                      (heap->flags & HEAP_POPULATE) != 0) < 0) {
+            return -1;
+         }
+         heap->committed = committed;
+      }
    }
    else
    {
@@ -138,350 +620,970 @@ s8int heap_resize(size_t new_size, struct heap *heap)
    return 0;
 }
 
-// find the smallest hole that will fit the requested size
-// if a hole is found, the index in the heap free list is returned
-// if a hole is not found, then -1 is returned
-// size must include the size of the header and footer, in addition to the
-// size that the actual users wishes to request
-ssize_t find_smallest_hole(size_t size,
-                           u8int page_align,
-                           struct heap *heap)
+// returns the unit a HEAP_VM heap's pages are committed and released in
+size_t commit_granularity(struct heap *heap)
 {
+   if(heap->flags & HEAP_HUGE_PAGES) {
+      return HEAP_HUGE_PAGE_SIZE;
+   }
 
-   // pseudocode:
-   // 1: iterate over free list
-   // 2: see if the chunk is large enough for the requested size - remember to
-   //    include page alignment!
-   // 3: if large enough, return
-   // 4: if not large enough, continue to the next chunk in the iteration
-   // 5: if the end is reached before a chunk is found, return -1
+   return PAGE_SIZE;
+}
 
-	//create size_t variable to use for iteration
-   size_t i = 0;
+// returns how much a heap of the given length grows by when an allocation
+// does not fit, before it is limited by the heap's max address or raised to
+// what the allocation needs
+size_t growth_step(size_t length, struct heap *heap)
+{
+   size_t growth = length / 100 * heap->growth_percent;
 
-   //header *header = (header *)sorted_array_lookup(i, &heap->)
+   if(growth < heap->growth_min) {
+      growth = heap->growth_min;
+   }
 
-	//iterate over size of free_list until a chunk is found
-	for(i; i < heap->free_list.size; i ++){
+   return growth;
+}
 
-      struct header *header = (struct header *)sorted_array_lookup(i , &heap->free_list);
+// decommits the pages of a HEAP_VM heap past its new end, which is end
+// the pages are only decommitted once more than a threshold past the end are
+// committed: HEAP_DECOMMIT_THRESHOLD bytes, two huge pages with
+// HEAP_HUGE_PAGES, or two of the steps the heap grows by from its new end,
+// whichever is most. The first half of the threshold then stays committed, so
+// that allocations and frees at the end of the heap, which grow it by a step
+// and contract it again, do not commit and decommit the same pages over and
+// over
+void heap_decommit(void *end, struct heap *heap)
+{
+   size_t granularity = commit_granularity(heap);
+   size_t threshold = HEAP_DECOMMIT_THRESHOLD;
+   size_t step = growth_step(end - heap->start_address, heap);
+   void *keep;
 
-      size_t loc = (size_t)header;
-      size_t offset = 0;
+   // a step is committed in whole units
+   step = (size_t)align_up((void *)step, granularity);
 
-      //calulate size of hole after you take out the header, this will give the size of what is actually
-      //available in each chunk, once page alignment has been taken into account.
+   if(threshold < 2 * granularity) {
+      threshold = 2 * granularity;
+   }
+   if(threshold < 2 * step) {
+      threshold = 2 * step;
+   }
+   if(heap->committed - end <= threshold) {
+      return;
+   }
+
+   keep = align_up(end + threshold / 2, granularity);
+   if(keep >= heap->committed) {
+      return;
+   }
+
+   vm_decommit(keep, heap->committed - keep);
+   heap->committed = keep;
+}
+
+// releases the memory behind the whole pages of a hole that hold nothing but
+// free space, up to budget bytes of them
+// returns the number of bytes released
+size_t scavenge_hole(struct header *hole, size_t budget, struct heap *heap)
+{
+   // the header is followed by the hole's index entry, if it has one, and
+   // min_block_size covers both
+   void *start = (void *)hole + min_block_size(heap) - sizeof(struct footer);
+   void *end = (void *)hole + block_size(hole) - sizeof(struct footer);
+   size_t granularity = commit_granularity(heap);
+
+   if(hole_purged(hole)) {
+      return 0;
+   }
+
+   // only whole (huge) pages are released, starting where an earlier call
+   // left off in this hole
+   start = align_up(start, granularity);
+   end = (void *)((size_t)end & ~(granularity - 1));
+   if(hole == heap->scavenging) {
+      start = heap->scavenged_to;
+   }
+
+   if(end > start && end - start > budget)
+   {
+      // out of budget; the next call carries on from here
+      end = start + (budget & ~(granularity - 1));
+      vm_purge(start, end - start);
+      heap->scavenging = hole;
+      heap->scavenged_to = end;
+
+      return end - start;
+   }
+
+   if(end > start) {
+      vm_purge(start, end - start);
+   }
+   set_purged(hole);
+   if(hole == heap->scavenging) {
+      heap->scavenging = NULL;
+   }
+
+   return (end > start) ? end - start : 0;
+}
+
+// returns 1 if heap_scavenge has released the hole since it was written
+u8int hole_purged(struct header *hole)
+{
+#ifdef HEAP_COMPACT
+   return (hole->size & HEAP_PURGED) != 0;
+#else
+   return hole->purged;
+#endif
+}
 
-      if(page_align)
+// returns 0 if the hole is in a HEAP_HUGE_PAGES heap and heap_scavenge has
+// released (some of) its pages, so that allocations go to the holes among the
+// huge pages in use first; 1 otherwise
+u8int hole_backed(struct header *hole, struct heap *heap)
+{
+   if(!(heap->flags & HEAP_HUGE_PAGES)) {
+      return 1;
+   }
+
+   return !hole_purged(hole) && hole != heap->scavenging;
+}
+
+// marks a hole as released by heap_scavenge; writing the hole again (as any
+// change to it does) clears the mark
+void set_purged(struct header *hole)
+{
+#ifdef HEAP_COMPACT
+   hole->size |= HEAP_PURGED;
+#else
+   hole->purged = 1;
+#endif
+}
+
+// grows the heap so that a block of the given size fits at the end of it
+// if the last chunk in the heap is a hole, it is extended; otherwise a new hole
+// is added after the old end address. Either way, that hole is the heap's top
+// afterwards
+// the heap grows by at least what its growth policy asks for (see
+// heap_set_growth), unless that would take it past max_address
+// returns a negative value on error, 0 on success
+s8int heap_expand(size_t size, size_t alignment, struct heap *heap)
+{
+   void *old_end = heap->end_address;
+   size_t length = old_end - heap->start_address;
+   struct header *top = heap->top;
+   size_t limit = (size_t)align((void *)(heap->max_address -
+                                         heap->start_address));
+   size_t growth;
+
+   // an aligned block may have to skip up to its alignment (plus a hole's
+   // worth of space) to reach it
+   if(alignment > 1) {
+      size += alignment + min_block_size(heap);
+   }
+
+   // the top hole is extended, so only the rest of the size is needed; the
+   // new space has to be able to hold a hole if there is no top hole
+   if(top != NULL && block_size(top) >= size) {
+      return 0;
+   }
+   if(top != NULL) {
+      size -= block_size(top);
+   }
+   else if(size < min_block_size(heap)) {
+      size = min_block_size(heap);
+   }
+
+   // grow geometrically, so that a run of allocations does not resize the
+   // heap every time, but no further than max_address; heap_resize fails if
+   // even the size that is needed does not fit
+   growth = growth_step(length, heap);
+   if(length + growth > limit) {
+      growth = (limit > length) ? limit - length : 0;
+   }
+   if(growth < size) {
+      growth = size;
+   }
+
+   if(heap_resize(length + growth, heap) < 0) {
+      return -1;
+   }
+
+   if(top != NULL)
+   {
+      // extend the hole at the top of the heap
+      hole_remove(top, heap);
+      add_hole(top, heap->end_address, heap);
+   }
+   else
+   {
+      add_hole(old_end, heap->end_address, heap);
+   }
+
+   return 0;
+}
+
+// find the smallest hole that will fit the requested size
+// if a hole is found, its header is returned
+// if a hole is not found, then NULL is returned
+// size must include the size of the header and footer, in addition to the
+// size that the actual users wishes to request
+// with HEAP_HUGE_PAGES, a hole whose pages heap_scavenge released is passed
+// over for the smallest hole that fits and is still backed, and only taken
+// if there is none; that keeps allocations packed into the huge pages in use
+struct header *find_smallest_hole(size_t size,
+                                  size_t alignment,
+                                  struct heap *heap)
+{
+   struct header *released = NULL;
+   size_t i;
+
+   // small requests are served from the bins in O(1), and carved from the
+   // main index only when no bin fits; the bins know nothing about alignment,
+   // so for an aligned request the bin's hole is only taken if it still fits
+   // once aligned
+   if(heap->flags & HEAP_SEGREGATED)
+   {
+      struct header *header = bin_find(size, heap);
+      if(header != NULL &&
+         block_size(header) >= size + align_offset(header, alignment, heap)) {
+         return header;
+      }
+   }
+
+   if(heap->flags & HEAP_FREE_TREE)
+   {
+      // start at the first hole that is large enough before alignment, and
+      // move to larger holes until one also fits after alignment
+      struct free_tree_node *node = free_tree_lower_bound(size,
+                                                          &heap->free_tree);
+      while(node != NULL)
       {
-         offset = PAGE_SIZE - (loc + sizeof(struct header))%PAGE_SIZE;
+         struct header *header = node_hole(node);
+
+         if(block_size(header) >= size +
+                                   align_offset(header, alignment, heap))
+         {
+            if(hole_backed(header, heap)) {
+               return header;
+            }
+            if(released == NULL) {
+               released = header;
+            }
+         }
+
+         node = free_tree_next(node);
       }
-      size_t hole_size = header->size - offset;
 
-      if(hole_size >= size)
+      return released;
+   }
+
+   // start at the first hole that is large enough before alignment
+   i = free_list_lower_bound(size, &heap->free_list);
+
+   // move to larger holes until one also fits after alignment; the sizes are
+   // kept in the list, and alignment only needs the hole's address, so no
+   // header is read until one fits (and then only with HEAP_HUGE_PAGES)
+   for(; i < heap->free_list.entries; i++)
+   {
+      struct header *header = heap->free_list.holes[i];
+
+      if(header == NULL) {
+         continue;
+      }
+
+      // the space available in the chunk, once alignment has been taken into
+      // account, has to be large enough
+      if(heap->free_list.sizes[i] >= size +
+                                     align_offset(header, alignment, heap))
       {
-         return i;
+         if(hole_backed(header, heap)) {
+            return header;
+         }
+         if(released == NULL) {
+            released = header;
+         }
       }
+   }
+
+   // no chunk with a valid size is found, unless it has been released
+   return released;
+}
+
+// returns how far into the hole a block has to start so that its data is
+// aligned on the given power of two, or 0 if it already is
+// the space that is skipped is always large enough to become a hole itself
+size_t align_offset(struct header *hole, size_t alignment, struct heap *heap)
+{
+   size_t data = (size_t)hole + sizeof(struct header);
+   size_t offset = -data & (alignment - 1);
+
+   // skip as many more alignments as it takes for the space to hold a hole
+   if(offset != 0 && offset < min_block_size(heap)) {
+      offset += (min_block_size(heap) - offset + alignment - 1) &
+                ~(alignment - 1);
+   }
+
+   return offset;
+}
+
+// writes a header and footer for a chunk of the given size at start
+// returns the header
+// with HEAP_COMPACT, allocated chunks get no footer, and the chunk is marked
+// as having an allocated block to its left (which is always true of holes);
+// callers fix that up with set_prev_allocated where needed
+struct header *write_chunk(void *start, size_t size, u8int allocated)
+{
+   struct header *header = (struct header *)start;
+   struct footer *footer;
 
-		//is the size contained in header larger than size needed?
-		//if(size < heap->free_list.size){
-			//return the chunk of memory;
-		//	return heap->free_list.storage[i];
-		//}
-	}
-	//no chunk with a valid size is found, return -1;
-  return -1;
+#ifdef HEAP_COMPACT
+#ifdef HEAP_DEBUG
+   header->magic = HEAP_MAGIC;
+#endif
+   header->size = size | HEAP_PREV_ALLOCATED | (allocated ? HEAP_ALLOCATED : 0);
+
+   if(allocated) {
+      return header;
+   }
+
+   footer = get_footer(header);
+#ifdef HEAP_DEBUG
+   footer->magic = HEAP_MAGIC;
+#endif
+   footer->header = header;
+#else
+   header->magic = HEAP_MAGIC;
+   header->size = size;
+   header->allocated = allocated;
+   header->purged = 0;
+
+   footer = get_footer(header);
+   footer->magic = HEAP_MAGIC;
+   footer->header = header;
+#endif
+
+   return header;
 }
 
 // creates and writes a hole that spans [start,end)
+// the hole must not touch any other hole; kfree_heap does the coalescing
 void add_hole(void *start, void *end, struct heap *heap)
 {
-   //make header
-   struct header *h;
-   h = (struct header *) start;
-   h->magic = HEAP_MAGIC;
-   h->size = end - start; //NOTE: DO WE NEED ERROR CHECKING HERE? if (end < start)?
-   h->allocated = 0;  // 0 = unallocated
+   // write the header and footer, and add the chunk to the free list
+   struct header *hole = write_chunk(start, end - start, 0);
 
-   //make footer
-   struct footer *f;
-   f = (struct footer *) end - sizeof(f);
-   f->magic = HEAP_MAGIC;
-   f->header = h;
+   hole_insert(hole, heap);
+}
 
-   
-   // add chunk to free list
-   sorted_array_insert(h, &(heap->free_list));
+// returns the size of the block that holds a request of the given size,
+// including the header and footer
+size_t request_block_size(size_t size, struct heap *heap)
+{
+   size_t granularity = block_granularity(heap);
+   size_t new_size = size + HEAP_BLOCK_OVERHEAD;
 
+   if(new_size < min_block_size(heap)) {
+      new_size = min_block_size(heap);
+   }
 
-   // pseudocode:
-   // 0. determine if coalesing is possible; if so, remove the appropriate
-   //    holes on either side of start and end, and then call add_hole
-   //    recursively on the larger region (can skip if no coalesing)
-   // 1. write header and footer to memory
-   // 2. add chunk to free list
+   // holes in the tree hold a node, so keep every block word-aligned; with
+   // bins, rounding to the bin spacing makes every hole in a request's own
+   // bin fit it
+   return (new_size + granularity - 1) & ~(granularity - 1);
 }
 
 void *kalloc_heap(size_t size, u8int page_align, struct heap *heap)
 {
-   // TODO: IMPLEMENT THIS FUNCTION
-
-   // pseudocode:
-   // 1. figure out size of needed free list entry (add size of header and
-   //    footer with sizeof(struct header) / sizeof(struct footer))
-   // 2. find a hole to allocate using find_smallest_hole
-   // 3. if no hole found, resize the heap, and then start again at 2
-   // 4. remove the found hole from the free list to use for allocation
-   // 5. page-align, if necessary
-   // 5.1. determine if page-alignment makes a good hole before our
-   //      allocation; if so, add that hole
-   // 6. mark the chunk as allocated, write the header/footer (if necessary)
-   // 7. return pointer to allocated portion of memory
-
-   size_t new_size = size + sizeof(struct header) + (sizeof(struct footer));
-
-   //use our find smallest hole
-   size_t iterator_result = find_smallest_hole(new_size, page_align, heap);
-
-   //if iterator is -1, then we didnt find a hole, otherwise allocate chuck at iterator location
-   if(iterator_result == -1)
-   {
-      //error check/reporting
-      //save the heap length and end address
-      size_t old_length = heap->end_address - heap->start_address;
-      size_t old_end_address = heap->end_address;
-      //allocate more room
-      size_t resize_result = heap_resize(old_length + new_size, heap);
-      if(resize_result == -1){
-				return;
-      	//heap did not resize, error out here
-      	//not sure how since we don't get to use the library for fprintf and stderr
+   return kalloc_heap_aligned(size, page_align ? PAGE_SIZE : 1, heap);
+}
+
+void *kalloc_heap_aligned(size_t size, size_t alignment, struct heap *heap)
+{
+   size_t new_size;
+   struct header *hole;
+   struct header *chunk_header;
+   size_t hole_loc;
+   size_t hole_size;
+   size_t offset;
+
+   if(alignment == 0 || (alignment & (alignment - 1)) != 0) {
+      return NULL;
+   }
+
+   // the size of the free list entry includes the header and footer
+   new_size = request_block_size(size, heap);
+   size = new_size - HEAP_BLOCK_OVERHEAD;
+
+   // make sure the holes this allocation leaves behind can be indexed: the
+   // space skipped to align the block, and the rest of the hole it is carved
+   // from (a new top hole is taken by the block or becomes that rest)
+   if(free_list_reserve(2, heap) < 0) {
+      return NULL;
+   }
+
+   hole = find_smallest_hole(new_size, alignment, heap);
+
+   if(hole == NULL)
+   {
+      // no hole found - grow the heap; the top hole then fits the block, and
+      // the block is carved from the start of it
+      if(heap_expand(new_size, alignment, heap) < 0) {
+         return NULL;
       }
-      //heap did resize
-      size_t new_length = heap->end_address - heap->start_address;
-      //find location of the last header in memory
-      iterator_result = 0;
-      //index and value of furthest header
-      size_t index = -1;
-      size_t value = 0x0;
-      while(iterator_result < heap->free_list.size)
-      {
-      	//get value of the header
-      	size_t tmp = (size_t)sorted_array_lookup(iterator_result, &heap->free_list);
-      	//replace value with this header value if it's larger, and set the index to the current iteration
-      	if(tmp > value)
-      	{
-      		value = tmp;
-      		index = iterator_result;
-      	}
+
+      hole = heap->top;
+   }
+
+   // remove the found hole from the free list to use for allocation
+   hole_remove(hole, heap);
+   hole_loc = (size_t)hole;
+   hole_size = block_size(hole);
+
+   // align, if necessary; the space that is skipped becomes a hole of its
+   // own, indexed under its own size
+   offset = align_offset(hole, alignment, heap);
+   if(offset > 0)
+   {
+      add_hole((void *)hole_loc, (void *)(hole_loc + offset), heap);
+      hole_loc += offset;
+      hole_size -= offset;
+   }
+
+   // if the rest of the hole would be too small to be a hole of its own, the
+   // block takes all of it
+   if(hole_size - new_size < min_block_size(heap)) {
+      new_size = hole_size;
+   }
+
+   // mark the chunk as allocated, and write the header/footer
+   chunk_header = write_chunk((void *)hole_loc, new_size, 1);
+   if(offset > 0) {
+      set_prev_allocated(chunk_header, 0);
+   }
+
+   // whatever is left over goes back into the free list
+   if(hole_size > new_size) {
+      add_hole((void *)(hole_loc + new_size), (void *)(hole_loc + hole_size),
+               heap);
+   }
+   else if((void *)(hole_loc + new_size) < heap->end_address) {
+      set_prev_allocated((struct header *)(hole_loc + new_size), 1);
+   }
+
+   return (void *)((size_t)chunk_header + sizeof(struct header));
+}
+
+s8int kalloc_heap_batch(size_t n,
+                        const size_t *sizes,
+                        void **out,
+                        struct heap *heap)
+{
+   struct header *hole;
+   void *p;
+   size_t total = 0;
+   size_t left;
+   size_t block;
+   size_t i;
+
+   if(n == 0) {
+      return 0;
+   }
+
+   // the blocks are carved one after the other, so they need one hole that
+   // holds them all
+   for(i = 0; i < n; i++)
+   {
+      block = request_block_size(sizes[i], heap);
+      if(total + block < total) {
+         return -1;
       }
-      
-      //if no headers were found, add a header.
-      if(index == -1){
-				add_hole(old_end_address, (old_end_address + (new_length-old_length) - sizeof(struct footer)), heap);
-			}
-			   
-      else
+      total += block;
+   }
+
+   // make sure the holes this allocation leaves behind can be indexed: a new
+   // top hole, and the rest of the hole the blocks are carved from
+   if(free_list_reserve(2, heap) < 0) {
+      return -1;
+   }
+
+   hole = find_smallest_hole(total, 0, heap);
+   if(hole == NULL && heap_expand(total, 0, heap) == 0) {
+      hole = find_smallest_hole(total, 0, heap);
+   }
+
+   if(hole == NULL)
+   {
+      // no hole holds the whole batch; the blocks may still fit one by one
+      for(i = 0; i < n; i++)
       {
-      	//a last header was found, adjust it
-      	struct header *new_header = sorted_array_lookup(index, &heap->free_list);
-      	//add the difference in sizes to be the new size
-      	new_header->size += new_length - old_length;
-      	struct footer *new_footer = (struct footer *)((size_t)new_header + new_header->size - sizeof(struct footer));
-      	new_footer->magic = HEAP_MAGIC;
-      	new_footer->header = new_header;
-				  
-				
-			}
-
-      //Now that we should have enough space, recall the function
-      return kalloc_heap(size, page_align, heap);
-   }
-
-   struct header *old_hole_header = (struct header *)sorted_array_lookup(iterator_result, &heap->free_list);
-   size_t old_hole_loc = (size_t)old_hole_header;
-   size_t old_hole_size = old_hole_header->size;
-
-
-   if((old_hole_size - new_size) < (sizeof(struct header) + sizeof(struct footer)))
-   {
-      size = size + old_hole_size - new_size;
-      new_size = old_hole_size;
-   }
-
-   //page alignment //TODO: make sure this is all correct
-   if(page_align && old_hole_loc&0xFFFFF000){
-      size_t new_loc = old_hole_loc + PAGE_SIZE - (old_hole_loc&0xFFF) - sizeof(struct header);
-      struct header *hole_header = (struct header *)old_hole_loc;
-      hole_header->size = PAGE_SIZE - (old_hole_loc&0xFFF) - sizeof(struct header);
-      hole_header->magic = HEAP_MAGIC;
-      //set chunk as unallocated
-      hole_header->allocated = 0;
-
-      struct footer *hole_foot = (struct footer *)((size_t)new_loc - sizeof(struct footer));
-      hole_foot->magic = HEAP_MAGIC;
-      hole_foot->header = hole_header;
-      old_hole_loc = new_loc;
-      old_hole_size = old_hole_size - hole_header->size;
-
-      //TODO
-      // Can you guys figure out what (old_hole_loc&0xFFF) is? I don't quite understand it. It may be replaceable by PAGE_MASK
-      //but im not sure
-      //Answer: old_hole_loc is the memory address of the location, 
-      //old_hole_loc&0xFFF maintains the highest order 12 bits of old_hole_loc
-      //while setting the remaining bits to 0
+         out[i] = kalloc_heap(sizes[i], 0, heap);
+         if(out[i] == NULL)
+         {
+            kfree_heap_batch(out, i, heap);
+            for(i = 0; i < n; i++) {
+               out[i] = NULL;
+            }
+
+            return -1;
+         }
+      }
+
+      return 0;
+   }
+
+   // one update to the free list takes the whole hole
+   hole_remove(hole, heap);
+   p = hole;
+   left = block_size(hole);
+
+   for(i = 0; i < n; i++)
+   {
+      block = request_block_size(sizes[i], heap);
+
+      // the last block takes whatever is too small to be a hole of its own
+      if(i == n - 1 && left - block < min_block_size(heap)) {
+         block = left;
+      }
+
+      write_chunk(p, block, 1);
+      out[i] = p + sizeof(struct header);
+      p += block;
+      left -= block;
+   }
+
+   // whatever is left over goes back into the free list
+   if(left > 0) {
+      add_hole(p, p + left, heap);
+   }
+   else if(p < heap->end_address) {
+      set_prev_allocated(p, 1);
+   }
+
+   return 0;
+}
+
+// resizes an allocated block to new_size (header and footer included) without
+// moving it, shrinking it or growing it into the hole to its right
+// returns 1 if the block was resized, 0 if the hole to the right is missing
+// or too small
+u8int resize_in_place(struct header *header, size_t new_size,
+                      struct heap *heap)
+{
+   size_t old_size = block_size(header);
+   u8int left_used = (left_hole(header, heap) == NULL);
+   struct header *right = (void *)header + old_size;
+   struct header *tail;
+   size_t total = old_size;
+
+   if(new_size <= old_size)
+   {
+      // a tail too small to be a hole stays part of the block
+      if(old_size - new_size < min_block_size(heap)) {
+         return 1;
+      }
+
+      // the tail becomes a block of its own, and freeing it coalesces it
+      // with whatever is to its right
+      write_chunk(header, new_size, 1);
+      set_prev_allocated(header, left_used);
+      tail = write_chunk((void *)header + new_size, old_size - new_size, 1);
+      kfree_heap((void *)tail + sizeof(struct header), heap);
+
+      return 1;
+   }
+
+   // there are never two holes next to each other, so the hole to the right
+   // is all the space there is
+   if((void *)right < heap->end_address && block_valid(right) &&
+      !block_allocated(right))
+   {
+      total += block_size(right);
+   }
+
+   if(total < new_size) {
+      return 0;
+   }
+
+   if(total > old_size) {
+      hole_remove(right, heap);
+   }
+
+   // whatever is left of the hole stays a hole; a tail too small to be a hole
+   // becomes part of the block
+   if(total - new_size < min_block_size(heap)) {
+      new_size = total;
+   }
+
+   write_chunk(header, new_size, 1);
+   set_prev_allocated(header, left_used);
+
+   if(total > new_size) {
+      add_hole((void *)header + new_size, (void *)header + total, heap);
+   }
+   else if((void *)header + new_size < heap->end_address) {
+      set_prev_allocated((void *)header + new_size, 1);
+   }
+
+   return 1;
+}
+
+void *krealloc_heap(void *p, size_t size, struct heap *heap)
+{
+   struct header *header;
+   size_t new_size;
+   void *moved;
+   size_t keep;
+
+   if(p == NULL) {
+      return kalloc_heap(size, 0, heap);
+   }
+
+   if(size == 0)
+   {
+      kfree_heap(p, heap);
+      return NULL;
+   }
+
+   header = (struct header*)((size_t)p - sizeof(struct header));
+   if(!block_valid(header) || !block_allocated(header)) {
+      return NULL;
+   }
+
+   // make sure the holes the resize leaves behind can be indexed; moving the
+   // block adds as many as an allocation, and one more for the old block
+   if(free_list_reserve(3, heap) < 0) {
+      return NULL;
+   }
+
+   new_size = request_block_size(size, heap);
+   if(resize_in_place(header, new_size, heap)) {
+      return p;
+   }
+
+   // a block at the end of the heap (possibly followed by a hole that ends
+   // there) can grow by growing the heap
+   if((void *)header + block_size(header) == heap->end_address ||
+      heap->top == (void *)header + block_size(header))
+   {
+      if(heap_expand(new_size - block_size(header), 0, heap) == 0 &&
+         resize_in_place(header, new_size, heap)) {
+         return p;
+      }
+   }
+
+   // as a last resort, move the data to a new block
+   moved = kalloc_heap(size, 0, heap);
+   if(moved == NULL) {
+      return NULL;
+   }
+
+   keep = heap_usable_size(p);
+   if(keep > size) {
+      keep = size;
+   }
+   memcpy(moved, p, keep);
+   if(kfree_heap(p, heap) < 0)
+   {
+      // the old block is left as it was, and the new one is given back
+      kfree_heap(moved, heap);
+      return NULL;
+   }
+
+   return moved;
+}
+
+void heap_set_growth(struct heap *heap, size_t percent, size_t min)
+{
+   heap->growth_percent = percent;
+   heap->growth_min = min;
+}
+
+size_t heap_scavenge(struct heap *heap, size_t budget)
+{
+   size_t smallest = HEAP_SCAVENGE_HOLE;
+   size_t released = 0;
+   size_t i;
+
+   if(!(heap->flags & HEAP_VM) || heap->freed < HEAP_SCAVENGE_FREED) {
+      return 0;
+   }
+
+   // a hole smaller than the unit pages are released in cannot hold one; and
+   // the budget is spent in whole units, so that a call only runs out of it
+   // in one hole
+   if(smallest < commit_granularity(heap)) {
+      smallest = commit_granularity(heap);
+   }
+   budget &= ~(commit_granularity(heap) - 1);
+
+   if(heap->flags & HEAP_FREE_TREE)
+   {
+      struct free_tree_node *node;
+
+      node = free_tree_lower_bound(smallest, &heap->free_tree);
+      for(; node != NULL && released < budget; node = free_tree_next(node)) {
+         released += scavenge_hole(node_hole(node), budget - released, heap);
+      }
    }
    else
    {
-     sorted_array_remove(iterator_result, &heap->free_list);
-   }
-
-   //create replacement headers for the chunk
-   struct header *chunk_header = (struct header *)old_hole_loc;
-   chunk_header->magic = HEAP_MAGIC;
-   //set chunk as allocated
-   chunk_header->allocated = 1;
-   chunk_header->size = new_size;
-
-   struct footer *chunk_footer = (struct footer *)(old_hole_loc + sizeof(struct header) + size);
-   chunk_footer->magic = HEAP_MAGIC;
-   chunk_footer->header = chunk_header;
-
-
-   //check if old_hole_size - new_size > 0
-   //if so, add new hole in that location.
-   if (old_hole_size - new_size > 0){
-      struct header *hole_header = (struct header *) (old_hole_loc + sizeof(struct header) + size + sizeof(struct footer));
-       hole_header->magic    = HEAP_MAGIC;
-       hole_header->allocated  = 0;
-       hole_header->size     = old_hole_size - new_size;
-       struct footer *hole_footer = (struct footer *) ( (size_t)hole_header + old_hole_size - new_size - sizeof(struct footer) );
-       if ((size_t)hole_footer < heap->end_address)
-       {
-           hole_footer->magic = HEAP_MAGIC;
-           hole_footer->header = hole_header;
-       }
-       sorted_array_insert((struct header*)hole_header, &heap->free_list);
-   }
-
-   return (void *)((size_t) chunk_header+sizeof(struct header));
-}
-
-void kfree_heap(void *p, struct heap *heap)
-{
-	//check if pointer is null	
-	if(p == 0) return;
-	if(p == NULL) return;
-	//get the header and footer from the pointer
-	struct header *p_header = (struct header*)((size_t)p - sizeof(struct header));
-	struct footer *p_footer = (struct footer*)((size_t)p_header + p_header->size - sizeof(struct footer));
-	//check that these headers and footers match our magic number
-	if(p_header->magic != HEAP_MAGIC) return;
-	if(p_footer->magic != HEAP_MAGIC) return;
-	//set p_header as unallocated
-	p_header->allocated = 0;
-	char add_to_free_list = 1;
-
-	//left
-
-	//get the footer from the left if it exists	
-	struct footer *left_footer = (struct footer*)((size_t)p_header - sizeof(struct footer));
-	//check if the magic number matches, and the segment is a hole	
-	if(left_footer->magic == HEAP_MAGIC && left_footer->header->allocated == 0)
-	{
-		//save the current size
-		size_t current_size = p_header->size;
-		//reassign our head to the head of the left footer
-		p_header = left_footer->header;
-		//reassign the footer to point to the new header location
-		p_footer->header = p_header;
-		//add on the size of the initial segment to the size of the left segment
-		p_header->size += current_size;
-		//don't re-add the header
-		add_to_free_list = 0;
-	}
-	
-
-	//right
-
-	//get the header to the right if it exists
-	struct header *right_header = (struct header*)((size_t)p_footer + sizeof(struct footer));
-	//check that magic num matches, and the segment is a hole
-	if(right_header->magic == HEAP_MAGIC && right_header->allocated == 0)
-	{
-		//add the size of the right segment to the current segment
-		p_header->size += right_header->size;
-		//get the footer of the new header, set our current footer to this footer.
-		struct footer *right_footer = (struct footer*)((size_t)right_header + right_header->size - sizeof(right_footer));
-		p_header = right_footer;
-		//find the iterator for the header to remove
-		size_t i = 0;
-		while((i < heap->free_list.size) && (sorted_array_lookup(i, &heap->free_list) != (struct header*)right_header))
-		{
-			i++;
-		}
-		//make sure the header was found
-		if(i >= heap->free_list.size) return;
-		
-		sorted_array_remove(i, &heap->free_list);
-	}
-
-	//if the footer is at the end of the structure, then contract the heap
-	if((size_t)p_footer + sizeof(struct footer) == heap->end_address)
-	{
-		//get the current length, and create the new length
-		size_t length = heap->end_address - heap->start_address;
-		size_t new_length = heap_resize(((size_t)p_header - (size_t)heap->start_address), heap);
-		
-		if(p_header->size - (length - new_length) > 0)
-		{
-			//resize
-			p_header->size -= length - new_length;
-			//change the footer location
-			p_footer = (struct footer*) ((size_t)p_header + p_header->size - sizeof(struct footer));
-			//set the magic			
-			p_footer->magic = HEAP_MAGIC;
-			//set the pointer to header			
-			p_footer->header = p_header;
-		}
-		else
-		{
-			//won't exist, remove from free_list
-			size_t i = 0;
-			//iterate to the header
-			while((i < heap->free_list.size) && (sorted_array_lookup(i, &heap->free_list) != (struct header*)right_header))
-			{
-				i++;
-			}
-			//remove the header, if the returned iterator is within the size of the list
-			if(i < heap->free_list.size)
-			{
-				sorted_array_remove(i, &heap->free_list);
-			}
-		}
-	}
-	if(add_to_free_list == 1)
-	{
-		sorted_array_insert((struct header*) p_header, &heap->free_list);
-	}
+      // the bins only hold holes smaller than HEAP_BIN_LIMIT, so every hole
+      // large enough to scavenge is in the main index
+      i = free_list_lower_bound(smallest, &heap->free_list);
+      for(; i < heap->free_list.entries && released < budget; i++)
+      {
+         if(heap->free_list.holes[i] != NULL) {
+            released += scavenge_hole(heap->free_list.holes[i],
+                                      budget - released, heap);
+         }
+      }
+   }
+
+   // a call that did not run out of budget has released every large hole, so
+   // there is nothing more to do until more is freed
+   if(released < budget && heap->scavenging == NULL) {
+      heap->freed = 0;
+   }
+
+   return released;
+}
+
+size_t heap_usable_size(void *p)
+{
+   struct header *header = (struct header*)((size_t)p - sizeof(struct header));
+
+   return block_size(header) - HEAP_BLOCK_OVERHEAD;
+}
+
+void heap_stats(struct heap *heap, struct heap_stats *stats)
+{
+   void *p = heap->start_address;
+
+   memset(stats, 0, sizeof(struct heap_stats));
+   stats->size = heap->end_address - heap->start_address;
+
+   // the blocks and holes tile the heap from its start to its end
+   while(p < heap->end_address)
+   {
+      struct header *header = p;
+      size_t size = block_size(header);
+
+      if(block_allocated(header))
+      {
+         stats->blocks++;
+         stats->allocated += size;
+      }
+      else
+      {
+         stats->holes++;
+         stats->free += size;
+         if(size > stats->largest_hole) {
+            stats->largest_hole = size;
+         }
+      }
+
+      p += size;
+   }
 }
 
+// returns 1 if the hole is indexed in the free list, rather than in a bin or
+// the tree
+u8int hole_listed(struct header *hole, struct heap *heap)
+{
+   if(heap->flags & HEAP_FREE_TREE) {
+      return 0;
+   }
 
+   return !(heap->flags & HEAP_SEGREGATED) ||
+          bin_index(block_size(hole)) >= HEAP_BIN_COUNT;
+}
 
+// returns 1 if [start,end), a run of allocated blocks, has a hole in the free
+// list on either side of it; releasing the run then merges it into that hole,
+// which adds no free list entry
+u8int beside_listed_hole(void *start, void *end, struct heap *heap)
+{
+   struct header *left = left_hole(start, heap);
+   struct header *right = end;
 
+   if(left != NULL && hole_listed(left, heap)) {
+      return 1;
+   }
 
+   return end < heap->end_address && block_valid(right) &&
+          !block_allocated(right) && hole_listed(right, heap);
+}
 
+// marks an allocated block as unallocated, without indexing it
+void mark_free(struct header *header)
+{
+#ifdef HEAP_COMPACT
+   header->size &= ~(size_t)HEAP_ALLOCATED;
+#else
+   header->allocated = 0;
+#endif
+}
 
+// turns [hole_start,hole_end), a run of blocks that have been marked as
+// unallocated, into a hole, coalescing it with the holes on either side and
+// contracting the heap if the hole ends at the end of it
+void release_range(void *hole_start, void *hole_end, struct heap *heap)
+{
+   struct header *left;
 
+   heap->freed += hole_end - hole_start;
 
+   //left
 
+   //take the left hole out of the free list, if there is one; it is re-added
+   //below as part of the coalesced hole
+   left = left_hole(hole_start, heap);
+   if(left != NULL)
+   {
+      hole_remove(left, heap);
+      hole_start = left;
+   }
 
+   //right
 
+   //get the header to the right if it exists
+   if(hole_end < heap->end_address)
+   {
+      struct header *right_header = hole_end;
+      //check that the segment is a hole
+      if(block_valid(right_header) && !block_allocated(right_header))
+      {
+         hole_remove(right_header, heap);
+         hole_end += block_size(right_header);
+      }
+   }
 
+   //if the hole is at the end of the heap, then contract the heap, leaving
+   //enough room for the hole itself
+   if(hole_end == heap->end_address)
+   {
+      size_t new_length = hole_start + min_block_size(heap) -
+                          heap->start_address;
+
+      if(heap_resize(new_length, heap) == 0) {
+         hole_end = heap->end_address;
+      }
+   }
 
+   //writing the hole marks it as unallocated
+   add_hole(hole_start, hole_end, heap);
 
+   //the block to the right now has a hole on its left
+   if(hole_end < heap->end_address) {
+      set_prev_allocated(hole_end, 0);
+   }
+}
 
+s8int kfree_heap(void *p, struct heap *heap)
+{
+   struct header *p_header;
+   void *p_end;
+
+   //check if pointer is null
+   if(p == NULL) return 0;
+
+   //get the header from the pointer
+   p_header = (struct header*)((size_t)p - sizeof(struct header));
+   p_end = (void *)p_header + block_size(p_header);
+
+   //check that the header and footer match our magic number, and that the
+   //block has not already been freed
+   if(!block_valid(p_header)) return 0;
+   if(!block_allocated(p_header)) return 0;
+
+   //make room in the free list for the hole; if the list is full and cannot
+   //grow, the block can only be freed into a hole that is already listed
+   if(free_list_reserve(1, heap) < 0 &&
+      !beside_listed_hole(p_header, p_end, heap)) {
+      return -1;
+   }
 
+   //set p_header as unallocated, and coalesce it with its neighbours
+   mark_free(p_header);
+   release_range(p_header, p_end, heap);
 
+   //give back free list storage that is no longer needed
+   free_list_trim(heap);
 
+   return 0;
+}
 
+// sorts pointers by address, with a shell sort, so that no memory is needed
+void sort_by_address(void **ptrs, size_t n)
+{
+   size_t gap;
+   size_t i;
+   size_t j;
+
+   for(gap = n / 2; gap > 0; gap /= 2)
+   {
+      for(i = gap; i < n; i++)
+      {
+         void *p = ptrs[i];
+
+         for(j = i; j >= gap && ptrs[j - gap] > p; j -= gap) {
+            ptrs[j] = ptrs[j - gap];
+         }
+         ptrs[j] = p;
+      }
+   }
+}
+
+s8int kfree_heap_batch(void **ptrs, size_t n, struct heap *heap)
+{
+   s8int result = 0;
+   size_t i = 0;
+
+   sort_by_address(ptrs, n);
+
+   while(i < n)
+   {
+      struct header *first = (struct header*)((size_t)ptrs[i] -
+                                              sizeof(struct header));
+      size_t start;
+      void *end;
+
+      // pointers that are NULL, not blocks, or already freed (including
+      // repeats in the batch) are skipped, as kfree_heap skips them
+      if(ptrs[i] == NULL || !block_valid(first) || !block_allocated(first))
+      {
+         i++;
+         continue;
+      }
+
+      // the blocks that follow each other in memory are released as one hole
+      end = (void *)first + block_size(first);
+      start = i++;
+      while(i < n && end < heap->end_address &&
+            ptrs[i] == end + sizeof(struct header) &&
+            block_valid(end) && block_allocated(end))
+      {
+         end += block_size((struct header *)end);
+         i++;
+      }
+
+      // make room in the free list for the hole before any block is marked;
+      // if there is none, the run is left allocated, as kfree_heap leaves it
+      if(free_list_reserve(1, heap) < 0 &&
+         !beside_listed_hole(first, end, heap))
+      {
+         result = -1;
+         continue;
+      }
+
+      for(; start < i; start++) {
+         mark_free((struct header *)((size_t)ptrs[start] -
+                                     sizeof(struct header)));
+      }
+      release_range(first, end, heap);
+   }
+
+   free_list_trim(heap);
+
+   return result;
+}
@@ -4,10 +4,117 @@
 #define KHEAP_H
 
 #include "common.h"
-#include "sorted_array.h"
+#include "free_list.h"
+#include "free_tree.h"
+#include "spinlock.h"
 
 #define HEAP_MAGIC          0x23456789
-#define HEAP_FREE_LIST_SIZE 0x20000
+
+// the free list starts with room for HEAP_FREE_LIST_INITIAL holes, right after
+// the heap struct. When fewer than HEAP_FREE_LIST_SLACK entries are left, the
+// list moves into a block twice the size, allocated from the heap itself;
+// when it is less than a quarter full, it moves into one half the size (back
+// into the initial storage once that is large enough). The slack covers the
+// most holes one call can add, plus an entry kept free for the allocation
+// that moves the list; if the list cannot grow, calls that would need more
+// entries than are left fail rather than leave a hole unindexed
+#define HEAP_FREE_LIST_INITIAL 0x40
+#define HEAP_FREE_LIST_SLACK   4
+
+// when an allocation does not fit, the heap grows by HEAP_GROWTH_PERCENT of
+// its size, or by HEAP_GROWTH_MIN bytes if that is more, so that a run of
+// allocations does not resize it every time; a larger allocation grows it by
+// only what it needs. heap_set_growth changes this for a heap
+#define HEAP_GROWTH_PERCENT 50
+#define HEAP_GROWTH_MIN     (16 * PAGE_SIZE)
+
+// with HEAP_VM, pages past the end of the heap are decommitted only once more
+// than HEAP_DECOMMIT_THRESHOLD bytes of them are committed, or twice what the
+// heap grows by from its end if that is more, and then the first half of that
+// stays committed, so that a heap whose end moves back and forth does not
+// commit and decommit the same pages each time
+#define HEAP_DECOMMIT_THRESHOLD (64 * PAGE_SIZE)
+
+// heap_scavenge only releases holes of at least HEAP_SCAVENGE_HOLE bytes, and
+// once it has released every such hole, does nothing more until
+// HEAP_SCAVENGE_FREED bytes have been freed
+#define HEAP_SCAVENGE_HOLE      (16 * PAGE_SIZE)
+#define HEAP_SCAVENGE_FREED     (64 * PAGE_SIZE)
+
+// heap creation flags, for heap_create_flags
+// HEAP_FREE_TREE: index the holes in a red-black tree that lives inside the
+// holes themselves, instead of in the free_list array; lookups, inserts and
+// removals are O(log n), and no free list storage is reserved. In this mode
+// allocation sizes are rounded up to a multiple of HEAP_TREE_ALIGN, and every
+// block is large enough to hold a tree node once it is freed
+#define HEAP_FREE_TREE      0x1
+// HEAP_SEGREGATED: keep small holes in size-class bins in front of the main
+// index (the free list, or the tree with HEAP_FREE_TREE); bin i holds holes
+// of size [i * HEAP_BIN_SPACING, (i + 1) * HEAP_BIN_SPACING), and a small
+// request is served from the first non-empty bin that fits it in O(1). Only
+// requests of HEAP_BIN_LIMIT or more, and aligned requests that the bin's
+// hole cannot hold once aligned, search the main index. In this mode block
+// sizes are rounded up to a multiple of HEAP_BIN_SPACING
+#define HEAP_SEGREGATED     0x2
+// HEAP_VM: set by heap_create_vm, whose space is address space reserved from
+// the OS; heap_resize commits pages as the heap grows, and decommits them as it
+// contracts, so that the memory the heap uses follows its size
+#define HEAP_VM             0x4
+// HEAP_POPULATE: with heap_create_vm, back pages with memory as soon as they
+// are committed, instead of as they are first touched
+#define HEAP_POPULATE       0x8
+// HEAP_HUGE_PAGES: with heap_create_vm, align the space to HEAP_HUGE_PAGE_SIZE
+// and ask for it to be backed by transparent huge pages. Pages are committed,
+// decommitted and scavenged a whole huge page at a time, so the heap never
+// breaks a huge page up by releasing part of it; and allocations are packed
+// into the huge pages already in use: a hole that heap_scavenge has released
+// is only used when no other hole fits, though before the heap grows
+#define HEAP_HUGE_PAGES     0x10
+
+#define HEAP_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#define HEAP_TREE_ALIGN     8
+
+#define HEAP_BIN_COUNT      64
+#define HEAP_BIN_SPACING    16
+#define HEAP_BIN_LIMIT      (HEAP_BIN_COUNT * HEAP_BIN_SPACING)
+
+#ifdef HEAP_COMPACT
+
+// with HEAP_COMPACT defined at build time, an allocated block is a one-word
+// header followed by the caller's data. The block size is always a multiple of
+// HEAP_TREE_ALIGN, so its low bits hold the block's allocated flag and the
+// allocated flag of the block to its left; that is what kfree_heap uses to
+// find a hole on the left, so footers are only written at the end of holes.
+// The magic numbers are only kept if HEAP_DEBUG is defined as well
+
+#define HEAP_ALLOCATED      0x1 // the block is in use
+#define HEAP_PREV_ALLOCATED 0x2 // the block to the left is in use
+#define HEAP_PURGED         0x4 // the hole was released by heap_scavenge
+#define HEAP_SIZE_BITS      (HEAP_TREE_ALIGN - 1)
+
+// header information for a memory block/hole
+struct header
+{
+#ifdef HEAP_DEBUG
+   u32int magic;     // magic number (used for identification / error checking)
+#endif
+   size_t size;      // size of the block, ORed with the HEAP_*ALLOCATED bits
+};
+
+// footer information for a hole
+struct footer
+{
+#ifdef HEAP_DEBUG
+   u32int magic;          // magic number, same as in header_t.
+#endif
+   struct header *header; // pointer to the hole header
+};
+
+// the metadata in an allocated block
+#define HEAP_BLOCK_OVERHEAD (sizeof(struct header))
+
+#else
 
 // header information for a memory block/hole
 struct header
@@ -15,6 +122,7 @@ struct header
    u32int magic;     // magic number (used for identification / error checking)
    size_t size;      // size of the block (including both the header and footer)
    u8int  allocated; // 1 if in use; 0 if free
+   u8int  purged;    // 1 if the hole was released by heap_scavenge
 };
 
 // footer information for a memory block/hole
@@ -24,10 +132,51 @@ struct footer
    struct header *header; // pointer to the block header
 };
 
+// the metadata in an allocated block
+#define HEAP_BLOCK_OVERHEAD (sizeof(struct header) + sizeof(struct footer))
+
+#endif // HEAP_COMPACT
+
+// links of a hole in a size-class bin, stored in the body of the hole
+struct bin_links
+{
+   struct header *next;
+   struct header *prev;
+};
+
+// a size-class bin, with counters for tuning the class boundaries
+// a request's class is the bin its block size (header and footer included)
+// falls in
+struct heap_bin
+{
+   struct header *head; // the most recently added hole in the bin
+   size_t holes;        // the number of holes currently in the bin
+   size_t hits;         // requests of this class served from this bin
+   size_t misses;       // requests of this class this bin could not serve
+   size_t borrowed;     // holes taken by requests of a smaller class
+};
+
 // the basic structure of the heap
 struct heap
 {
-   struct sorted_array free_list;
+   struct free_list free_list;  // the hole index, unless HEAP_FREE_TREE is set
+   u8int free_list_moving;      // set while the free list changes storage
+   struct free_tree free_tree;  // the hole index if HEAP_FREE_TREE is set
+   u32int flags;                // HEAP_* creation flags
+   struct heap_bin bins[HEAP_BIN_COUNT]; // used if HEAP_SEGREGATED is set
+   u64int bin_map;              // bit i is set if bins[i] is not empty
+   struct header *top;          // the hole that ends at end_address, or NULL
+                                // if the last block is in use
+   void   *committed;           // with HEAP_VM, the end of the committed
+                                // pages; at or past end_address
+   size_t freed;                // bytes freed since heap_scavenge last
+                                // released every large hole
+   struct header *scavenging;   // a hole heap_scavenge ran out of budget in,
+   void   *scavenged_to;        // and the end of the pages it released in it
+   size_t growth_percent;       // the heap grows by this share of its size,
+   size_t growth_min;           // or by at least this many bytes
+   struct spinlock lock;        // held by the thread-safe (tcache.h) calls;
+                                // kalloc_heap and kfree_heap do not take it
    void   *start_address; // the start of the space in which memory can be
                           // allocated (free_list is not included)
    void   *end_address;   // the end of the allocated space
@@ -35,19 +184,114 @@ struct heap
                           // past the end of end_address
 };
 
+// a summary of a heap's blocks, from heap_stats
+struct heap_stats
+{
+   size_t size;         // the bytes between the heap's start and end
+   size_t blocks;       // the number of allocated blocks
+   size_t allocated;    // the bytes in allocated blocks, metadata included
+   size_t holes;        // the number of holes
+   size_t free;         // the bytes in holes
+   size_t largest_hole; // the size of the largest hole
+};
+
 // creates a heap
 // start is the start point
 // end is the end of the allocated region
 // max is the maximum point to which the heap can expand
 struct heap *heap_create(void *start, void *end, void *max);
 
+// creates a heap, as heap_create, with the given HEAP_* flags
+struct heap *heap_create_flags(void *start, void *end, void *max, u32int flags);
+
+// creates a heap, as heap_create_flags, in address space reserved from the OS
+// for max bytes, with initial bytes of it committed; HEAP_VM is added to the
+// flags. initial is raised to hold the heap struct and at least a page of data
+// with HEAP_HUGE_PAGES, initial and max are rounded up to whole huge pages
+// returns NULL if the space cannot be reserved or committed
+struct heap *heap_create_vm(size_t initial, size_t max, u32int flags);
+
+// releases a heap created with heap_create_vm, and all of its space
+void heap_destroy_vm(struct heap *heap);
+
 // allocates a continguous region of memory that is of size 'size'
 // if page_align is 1, then the returned memory is aligned on a page boundary
+// returns NULL if the heap cannot grow large enough
 void *kalloc_heap(size_t size, u8int page_align, struct heap *heap);
 
+// allocates a region of memory of the given size, as kalloc_heap, whose
+// address is a multiple of alignment
+// alignment must be a power of two; holes are judged by what they can hold
+// once aligned, and the space skipped to reach the alignment is left as a hole
+// of its own
+// returns NULL if alignment is not a power of two, or if the heap cannot grow
+// large enough
+void *kalloc_heap_aligned(size_t size, size_t alignment, struct heap *heap);
+
+// allocates n blocks, as kalloc_heap(sizes[i], 0, heap), storing them in
+// out[0..n)
+// when one hole holds them all, the blocks are carved from it one after the
+// other, with one free list search and one update
+// returns a negative value if any of the blocks cannot be allocated, in which
+// case none are and out is filled with NULL; 0 on success
+s8int kalloc_heap_batch(size_t n,
+                        const size_t *sizes,
+                        void **out,
+                        struct heap *heap)
+                        WARN_UNUSED;
+
+// resizes a block allocated with kalloc_heap, keeping its contents up to the
+// smaller of the old and new sizes
+// the block is resized in place when it can be: shrinking splits off its tail
+// as a hole, and growing takes space from the hole to its right (growing the
+// heap if the block is at the end of it). Otherwise the data is moved to a
+// new block, which is not page-aligned, and the old block is freed
+// p may be NULL, in which case this is kalloc_heap(size, 0, heap); if size is
+// 0, the block is freed and NULL is returned
+// returns NULL if the block cannot be resized, in which case it is left as
+// it was
+void *krealloc_heap(void *p, size_t size, struct heap *heap);
+
+// sets how much the heap grows by when an allocation does not fit: percent of
+// its current size, or min bytes if that is more, but never less than the
+// allocation needs. A percent and min of 0 grow it by only what is needed
+void heap_set_growth(struct heap *heap, size_t percent, size_t min);
+
+// returns how many bytes the caller can use in a block allocated with
+// kalloc_heap; this is at least the size that was asked for
+size_t heap_usable_size(void *p);
+
+// fills in stats for the heap, by walking every block in it
+// this takes time in proportion to the number of blocks, whichever index the
+// heap uses
+void heap_stats(struct heap *heap, struct heap_stats *stats);
+
+// gives the memory behind the pages inside large holes of a HEAP_VM heap back
+// to the OS; the pages a hole's header, index entry and footer are on are kept
+// the pages stay committed, and are backed by memory again when they are next
+// touched. At most budget bytes are released; a call that runs out of budget
+// is picked up where it left off by the next one. Holes stay marked as
+// released until they change, and are skipped. Once every large hole has been
+// released, nothing is done until HEAP_SCAVENGE_FREED more bytes have been
+// freed, so this can be called as often as is convenient
+// returns the number of bytes newly released; 0 if the heap is not a HEAP_VM
+// heap
+size_t heap_scavenge(struct heap *heap, size_t budget);
+
 // releases a block that was allocated using kalloc
 // p is the pointer to release
 // heap is the heap that the memory came from
-void kfree_heap(void *p, struct heap *heap);
+// returns a negative value if the free list is full and cannot grow to index
+// the hole, in which case the block is left allocated and can be freed again
+// later (a block next to a hole in the free list can always be freed); 0
+// otherwise
+s8int kfree_heap(void *p, struct heap *heap);
+
+// releases n blocks, as kfree_heap does for each of them
+// ptrs is sorted by address in place, so that blocks next to each other are
+// coalesced into one hole with one free list update
+// returns a negative value if any of the blocks were left allocated, as
+// kfree_heap leaves them; 0 otherwise
+s8int kfree_heap_batch(void **ptrs, size_t n, struct heap *heap);
 
 #endif // KHEAP_H
@@ -0,0 +1,207 @@
+// Memcmp implementation
+
+#include "memcmp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MEMCMP_X86
+#include <immintrin.h>
+#endif
+
+// a word that may alias any other type
+typedef size_t __attribute__((may_alias)) memcmp_word;
+
+// headers for local functions
+int memcmp_bytes(const void *s1, const void *s2, size_t n);
+int memcmp_words(const void *s1, const void *s2, size_t n);
+int memcmp_sse2(const void *s1, const void *s2, size_t n);
+int memcmp_avx2(const void *s1, const void *s2, size_t n);
+
+// the variant memcmp uses; NULL until the first comparison picks one
+int (*memcmp_compare)(const void *, const void *, size_t) = NULL;
+
+// compares one byte at a time
+int memcmp_bytes(const void *s1, const void *s2, size_t n)
+{
+   const unsigned char *a = s1;
+   const unsigned char *b = s2;
+   size_t i;
+
+   for(i = 0; i < n; i++)
+   {
+      if(a[i] != b[i]) {
+         return a[i] - b[i];
+      }
+   }
+
+   return 0;
+}
+
+// compares one word at a time, if both areas have the same alignment within a
+// word, and one byte at a time otherwise; the bytes of the first word that
+// differs are compared one at a time to find the first difference
+int memcmp_words(const void *s1, const void *s2, size_t n)
+{
+   const unsigned char *a = s1;
+   const unsigned char *b = s2;
+   size_t head = -(size_t)a & (sizeof(size_t) - 1);
+   int result;
+
+   if((((size_t)a ^ (size_t)b) & (sizeof(size_t) - 1)) != 0) {
+      return memcmp_bytes(s1, s2, n);
+   }
+
+   if(n < head) {
+      head = n;
+   }
+   result = memcmp_bytes(a, b, head);
+   if(result != 0) {
+      return result;
+   }
+   a += head;
+   b += head;
+   n -= head;
+
+   while(n >= sizeof(size_t))
+   {
+      if(*(const memcmp_word *)a != *(const memcmp_word *)b) {
+         return memcmp_bytes(a, b, sizeof(size_t));
+      }
+      a += sizeof(size_t);
+      b += sizeof(size_t);
+      n -= sizeof(size_t);
+   }
+
+   return memcmp_bytes(a, b, n);
+}
+
+#ifdef MEMCMP_X86
+
+// compares 16 bytes at a time
+// n must be at least MEMSET_SMALL
+__attribute__((target("sse2")))
+int memcmp_sse2(const void *s1, const void *s2, size_t n)
+{
+   const unsigned char *a = s1;
+   const unsigned char *b = s2;
+   u32int mask;
+
+   while(1)
+   {
+      // the last block overlaps the one before it, whose bytes are equal
+      if(n < 16)
+      {
+         a -= 16 - n;
+         b -= 16 - n;
+         n = 16;
+      }
+
+      mask = _mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)a),
+                               _mm_loadu_si128((const __m128i *)b)));
+      if(mask != 0xffff)
+      {
+         mask = __builtin_ctz(~mask);
+         return a[mask] - b[mask];
+      }
+
+      if(n == 16) {
+         return 0;
+      }
+      a += 16;
+      b += 16;
+      n -= 16;
+   }
+}
+
+// compares 32 bytes at a time
+// n must be at least MEMSET_SMALL
+__attribute__((target("avx2")))
+int memcmp_avx2(const void *s1, const void *s2, size_t n)
+{
+   const unsigned char *a = s1;
+   const unsigned char *b = s2;
+   u32int mask;
+
+   while(1)
+   {
+      // the last block overlaps the one before it, whose bytes are equal
+      if(n < 32)
+      {
+         a -= 32 - n;
+         b -= 32 - n;
+         n = 32;
+      }
+
+      mask = _mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)a),
+                                  _mm256_loadu_si256((const __m256i *)b)));
+      if(mask != 0xffffffff)
+      {
+         mask = __builtin_ctz(~mask);
+         return a[mask] - b[mask];
+      }
+
+      if(n == 32) {
+         return 0;
+      }
+      a += 32;
+      b += 32;
+      n -= 32;
+   }
+}
+
+#else
+
+// without x86 vector registers, the widest comparison is a word at a time
+int memcmp_sse2(const void *s1, const void *s2, size_t n)
+{
+   return memcmp_words(s1, s2, n);
+}
+
+int memcmp_avx2(const void *s1, const void *s2, size_t n)
+{
+   return memcmp_words(s1, s2, n);
+}
+
+#endif // MEMCMP_X86
+
+u32int memcmp_use(u32int variant)
+{
+   u32int best = memset_best();
+
+   if(variant > best) {
+      variant = best;
+   }
+
+   switch(variant)
+   {
+      case MEMSET_BYTES:
+         memcmp_compare = &memcmp_bytes;
+         break;
+      case MEMSET_WORDS:
+         memcmp_compare = &memcmp_words;
+         break;
+      case MEMSET_SSE2:
+         memcmp_compare = &memcmp_sse2;
+         break;
+      default:
+         memcmp_compare = &memcmp_avx2;
+         break;
+   }
+
+   return variant;
+}
+
+int memcmp(const void *s1, const void *s2, size_t n)
+{
+   if(n < MEMSET_SMALL) {
+      return memcmp_bytes(s1, s2, n);
+   }
+
+   // several threads may race to pick the variant, but they all pick the same
+   if(memcmp_compare == NULL) {
+      memcmp_use(memset_best());
+   }
+
+   return memcmp_compare(s1, s2, n);
+}
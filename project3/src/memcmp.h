@@ -0,0 +1,23 @@
+// Memcmp header
+
+#ifndef MEMCMP_H
+#define MEMCMP_H
+
+#include "common.h"
+#include "memset.h"
+
+// memcmp compares with the widest loads the CPU supports, using the same
+// MEMSET_* variants as memset; the variant is picked on the first call, and
+// can be overridden with memcmp_use
+
+// compares the first n bytes of s1 and s2, as unsigned chars
+// returns a negative value if s1 sorts first, 0 if they are the same, and a
+// positive value if s2 sorts first
+int memcmp(const void *s1, const void *s2, size_t n);
+
+// makes memcmp use the given MEMSET_* variant, or the fastest supported one
+// if the CPU does not support it
+// returns the variant now in use
+u32int memcmp_use(u32int variant);
+
+#endif // MEMCMP_H
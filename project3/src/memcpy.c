@@ -0,0 +1,464 @@
+// Memcpy and memmove implementation
+
+#include "memcpy.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MEMCPY_X86
+#include <immintrin.h>
+#endif
+
+// a word that may alias any other type
+typedef size_t __attribute__((may_alias)) memcpy_word;
+
+// headers for local functions
+void *memcpy_bytes(void *dest, const void *src, size_t n);
+void *memcpy_words(void *dest, const void *src, size_t n);
+void *memcpy_sse2(void *dest, const void *src, size_t n);
+void *memcpy_avx2(void *dest, const void *src, size_t n);
+void *memmove_bytes(void *dest, const void *src, size_t n);
+void *memmove_words(void *dest, const void *src, size_t n);
+void *memmove_sse2(void *dest, const void *src, size_t n);
+void *memmove_avx2(void *dest, const void *src, size_t n);
+
+// the variants memcpy and memmove use; NULL until the first copy picks them
+// the memmove variants are only used for areas that overlap
+void *(*memcpy_copy)(void *, const void *, size_t) = NULL;
+void *(*memcpy_move)(void *, const void *, size_t) = NULL;
+
+// copies one byte at a time, front to back
+void *memcpy_bytes(void *dest, const void *src, size_t n)
+{
+   size_t i;
+
+   for(i = 0; i < n; i++) {
+      ((unsigned char *)dest)[i] = ((const unsigned char *)src)[i];
+   }
+
+   return dest;
+}
+
+// copies one word at a time, if both areas have the same alignment within a
+// word, and one byte at a time otherwise
+void *memcpy_words(void *dest, const void *src, size_t n)
+{
+   unsigned char *d = dest;
+   const unsigned char *s = src;
+   size_t head = -(size_t)d & (sizeof(size_t) - 1);
+
+   if((((size_t)d ^ (size_t)s) & (sizeof(size_t) - 1)) != 0) {
+      return memcpy_bytes(dest, src, n);
+   }
+
+   if(n < head) {
+      head = n;
+   }
+   memcpy_bytes(d, s, head);
+   d += head;
+   s += head;
+   n -= head;
+
+   while(n >= sizeof(size_t))
+   {
+      *(memcpy_word *)d = *(const memcpy_word *)s;
+      d += sizeof(size_t);
+      s += sizeof(size_t);
+      n -= sizeof(size_t);
+   }
+
+   memcpy_bytes(d, s, n);
+
+   return dest;
+}
+
+// copies one byte at a time, in whichever direction is safe if the areas
+// overlap
+void *memmove_bytes(void *dest, const void *src, size_t n)
+{
+   unsigned char *d = dest;
+   const unsigned char *s = src;
+
+   if(d <= s) {
+      return memcpy_bytes(dest, src, n);
+   }
+
+   while(n > 0)
+   {
+      n--;
+      d[n] = s[n];
+   }
+
+   return dest;
+}
+
+// copies overlapping areas one word at a time, if both areas have the same
+// alignment within a word, and one byte at a time otherwise
+void *memmove_words(void *dest, const void *src, size_t n)
+{
+   unsigned char *d = dest;
+   const unsigned char *s = src;
+   size_t edge;
+
+   if((((size_t)d ^ (size_t)s) & (sizeof(size_t) - 1)) != 0) {
+      return memmove_bytes(dest, src, n);
+   }
+
+   if(d < s)
+   {
+      // front to back, so that each word is read before it is overwritten
+      return memcpy_words(dest, src, n);
+   }
+
+   // back to front, starting with the bytes after the last whole word
+   edge = (size_t)(d + n) & (sizeof(size_t) - 1);
+   if(n < edge) {
+      edge = n;
+   }
+   n -= edge;
+   memmove_bytes(d + n, s + n, edge);
+
+   while(n >= sizeof(size_t))
+   {
+      n -= sizeof(size_t);
+      *(memcpy_word *)(d + n) = *(const memcpy_word *)(s + n);
+   }
+
+   memmove_bytes(d, s, n);
+
+   return dest;
+}
+
+#ifdef MEMCPY_X86
+
+// copies 16 bytes at a time to an aligned address
+// n must be at least MEMSET_SMALL, and the areas must not overlap
+__attribute__((target("sse2")))
+void *memcpy_sse2(void *dest, const void *src, size_t n)
+{
+   unsigned char *d = dest;
+   const unsigned char *s = src;
+   size_t head = -(size_t)d & 15;
+
+   // one unaligned copy covers the head, and another the tail
+   __m128i last = _mm_loadu_si128((const __m128i *)(s + n - 16));
+   _mm_storeu_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+   _mm_storeu_si128((__m128i *)(d + n - 16), last);
+   d += head;
+   s += head;
+   n -= head;
+
+   if(n >= MEMCPY_STREAM_SIZE)
+   {
+      for(; n >= 64; d += 64, s += 64, n -= 64)
+      {
+         __m128i a = _mm_loadu_si128((const __m128i *)s);
+         __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+         __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+         __m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+         _mm_stream_si128((__m128i *)d, a);
+         _mm_stream_si128((__m128i *)(d + 16), b);
+         _mm_stream_si128((__m128i *)(d + 32), c);
+         _mm_stream_si128((__m128i *)(d + 48), e);
+      }
+      _mm_sfence();
+   }
+
+   for(; n >= 64; d += 64, s += 64, n -= 64)
+   {
+      __m128i a = _mm_loadu_si128((const __m128i *)s);
+      __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+      __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+      __m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+      _mm_store_si128((__m128i *)d, a);
+      _mm_store_si128((__m128i *)(d + 16), b);
+      _mm_store_si128((__m128i *)(d + 32), c);
+      _mm_store_si128((__m128i *)(d + 48), e);
+   }
+   for(; n >= 16; d += 16, s += 16, n -= 16) {
+      _mm_store_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+   }
+
+   return dest;
+}
+
+// copies 32 bytes at a time to an aligned address
+// n must be at least MEMSET_SMALL, and the areas must not overlap
+__attribute__((target("avx2")))
+void *memcpy_avx2(void *dest, const void *src, size_t n)
+{
+   unsigned char *d = dest;
+   const unsigned char *s = src;
+   size_t head = -(size_t)d & 31;
+
+   // one unaligned copy covers the head, and another the tail
+   __m256i last = _mm256_loadu_si256((const __m256i *)(s + n - 32));
+   _mm256_storeu_si256((__m256i *)d, _mm256_loadu_si256((const __m256i *)s));
+   _mm256_storeu_si256((__m256i *)(d + n - 32), last);
+   d += head;
+   s += head;
+   n -= head;
+
+   if(n >= MEMCPY_STREAM_SIZE)
+   {
+      for(; n >= 128; d += 128, s += 128, n -= 128)
+      {
+         __m256i a = _mm256_loadu_si256((const __m256i *)s);
+         __m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+         __m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+         __m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+         _mm256_stream_si256((__m256i *)d, a);
+         _mm256_stream_si256((__m256i *)(d + 32), b);
+         _mm256_stream_si256((__m256i *)(d + 64), c);
+         _mm256_stream_si256((__m256i *)(d + 96), e);
+      }
+      _mm_sfence();
+   }
+
+   for(; n >= 128; d += 128, s += 128, n -= 128)
+   {
+      __m256i a = _mm256_loadu_si256((const __m256i *)s);
+      __m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+      __m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+      __m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+      _mm256_store_si256((__m256i *)d, a);
+      _mm256_store_si256((__m256i *)(d + 32), b);
+      _mm256_store_si256((__m256i *)(d + 64), c);
+      _mm256_store_si256((__m256i *)(d + 96), e);
+   }
+   for(; n >= 32; d += 32, s += 32, n -= 32) {
+      _mm256_store_si256((__m256i *)d, _mm256_loadu_si256((const __m256i *)s));
+   }
+
+   return dest;
+}
+
+// copies overlapping areas 16 bytes at a time to aligned addresses
+// every block is loaded before any of it is stored, and the copy runs away
+// from the part of the source that the stores overwrite
+__attribute__((target("sse2")))
+void *memmove_sse2(void *dest, const void *src, size_t n)
+{
+   unsigned char *d = dest;
+   const unsigned char *s = src;
+   size_t edge;
+
+   if(d < s)
+   {
+      edge = -(size_t)d & 15;
+      if(n < edge) {
+         edge = n;
+      }
+      memmove_bytes(d, s, edge);
+      d += edge;
+      s += edge;
+      n -= edge;
+
+      for(; n >= 64; d += 64, s += 64, n -= 64)
+      {
+         __m128i a = _mm_loadu_si128((const __m128i *)s);
+         __m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+         __m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+         __m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+         _mm_store_si128((__m128i *)d, a);
+         _mm_store_si128((__m128i *)(d + 16), b);
+         _mm_store_si128((__m128i *)(d + 32), c);
+         _mm_store_si128((__m128i *)(d + 48), e);
+      }
+      for(; n >= 16; d += 16, s += 16, n -= 16) {
+         _mm_store_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+      }
+
+      memmove_bytes(d, s, n);
+
+      return dest;
+   }
+
+   edge = (size_t)(d + n) & 15;
+   if(n < edge) {
+      edge = n;
+   }
+   n -= edge;
+   memmove_bytes(d + n, s + n, edge);
+
+   while(n >= 64)
+   {
+      n -= 64;
+      __m128i a = _mm_loadu_si128((const __m128i *)(s + n));
+      __m128i b = _mm_loadu_si128((const __m128i *)(s + n + 16));
+      __m128i c = _mm_loadu_si128((const __m128i *)(s + n + 32));
+      __m128i e = _mm_loadu_si128((const __m128i *)(s + n + 48));
+      _mm_store_si128((__m128i *)(d + n + 48), e);
+      _mm_store_si128((__m128i *)(d + n + 32), c);
+      _mm_store_si128((__m128i *)(d + n + 16), b);
+      _mm_store_si128((__m128i *)(d + n), a);
+   }
+   while(n >= 16)
+   {
+      n -= 16;
+      _mm_store_si128((__m128i *)(d + n),
+                      _mm_loadu_si128((const __m128i *)(s + n)));
+   }
+
+   memmove_bytes(d, s, n);
+
+   return dest;
+}
+
+// copies overlapping areas 32 bytes at a time to aligned addresses, as
+// memmove_sse2 does
+__attribute__((target("avx2")))
+void *memmove_avx2(void *dest, const void *src, size_t n)
+{
+   unsigned char *d = dest;
+   const unsigned char *s = src;
+   size_t edge;
+
+   if(d < s)
+   {
+      edge = -(size_t)d & 31;
+      if(n < edge) {
+         edge = n;
+      }
+      memmove_bytes(d, s, edge);
+      d += edge;
+      s += edge;
+      n -= edge;
+
+      for(; n >= 128; d += 128, s += 128, n -= 128)
+      {
+         __m256i a = _mm256_loadu_si256((const __m256i *)s);
+         __m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+         __m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+         __m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+         _mm256_store_si256((__m256i *)d, a);
+         _mm256_store_si256((__m256i *)(d + 32), b);
+         _mm256_store_si256((__m256i *)(d + 64), c);
+         _mm256_store_si256((__m256i *)(d + 96), e);
+      }
+      for(; n >= 32; d += 32, s += 32, n -= 32) {
+         _mm256_store_si256((__m256i *)d,
+                            _mm256_loadu_si256((const __m256i *)s));
+      }
+
+      memmove_bytes(d, s, n);
+
+      return dest;
+   }
+
+   edge = (size_t)(d + n) & 31;
+   if(n < edge) {
+      edge = n;
+   }
+   n -= edge;
+   memmove_bytes(d + n, s + n, edge);
+
+   while(n >= 128)
+   {
+      n -= 128;
+      __m256i a = _mm256_loadu_si256((const __m256i *)(s + n));
+      __m256i b = _mm256_loadu_si256((const __m256i *)(s + n + 32));
+      __m256i c = _mm256_loadu_si256((const __m256i *)(s + n + 64));
+      __m256i e = _mm256_loadu_si256((const __m256i *)(s + n + 96));
+      _mm256_store_si256((__m256i *)(d + n + 96), e);
+      _mm256_store_si256((__m256i *)(d + n + 64), c);
+      _mm256_store_si256((__m256i *)(d + n + 32), b);
+      _mm256_store_si256((__m256i *)(d + n), a);
+   }
+   while(n >= 32)
+   {
+      n -= 32;
+      _mm256_store_si256((__m256i *)(d + n),
+                         _mm256_loadu_si256((const __m256i *)(s + n)));
+   }
+
+   memmove_bytes(d, s, n);
+
+   return dest;
+}
+
+#else
+
+// without x86 vector registers, the widest copy is a word at a time
+void *memcpy_sse2(void *dest, const void *src, size_t n)
+{
+   return memcpy_words(dest, src, n);
+}
+
+void *memcpy_avx2(void *dest, const void *src, size_t n)
+{
+   return memcpy_words(dest, src, n);
+}
+
+void *memmove_sse2(void *dest, const void *src, size_t n)
+{
+   return memmove_words(dest, src, n);
+}
+
+void *memmove_avx2(void *dest, const void *src, size_t n)
+{
+   return memmove_words(dest, src, n);
+}
+
+#endif // MEMCPY_X86
+
+u32int memcpy_use(u32int variant)
+{
+   u32int best = memset_best();
+
+   if(variant > best) {
+      variant = best;
+   }
+
+   switch(variant)
+   {
+      case MEMSET_BYTES:
+         memcpy_move = &memmove_bytes;
+         memcpy_copy = &memcpy_bytes;
+         break;
+      case MEMSET_WORDS:
+         memcpy_move = &memmove_words;
+         memcpy_copy = &memcpy_words;
+         break;
+      case MEMSET_SSE2:
+         memcpy_move = &memmove_sse2;
+         memcpy_copy = &memcpy_sse2;
+         break;
+      default:
+         memcpy_move = &memmove_avx2;
+         memcpy_copy = &memcpy_avx2;
+         break;
+   }
+
+   return variant;
+}
+
+void *memcpy(void *dest, const void *src, size_t n)
+{
+   if(n < MEMSET_SMALL) {
+      return memcpy_bytes(dest, src, n);
+   }
+
+   // several threads may race to pick the variant, but they all pick the same
+   if(memcpy_copy == NULL) {
+      memcpy_use(memset_best());
+   }
+
+   return memcpy_copy(dest, src, n);
+}
+
+void *memmove(void *dest, const void *src, size_t n)
+{
+   if(n < MEMSET_SMALL) {
+      return memmove_bytes(dest, src, n);
+   }
+
+   // areas that do not overlap are copied as fast as memcpy can
+   if(dest + n <= src || src + n <= dest) {
+      return memcpy(dest, src, n);
+   }
+
+   if(memcpy_move == NULL) {
+      memcpy_use(memset_best());
+   }
+
+   return memcpy_move(dest, src, n);
+}
@@ -0,0 +1,30 @@
+// Memcpy and memmove header
+
+#ifndef MEMCPY_H
+#define MEMCPY_H
+
+#include "common.h"
+#include "memset.h"
+
+// memcpy and memmove copy with the widest loads and stores the CPU supports,
+// using the same MEMSET_* variants as memset; the variant is picked on the
+// first call, and can be overridden with memcpy_use
+//
+// copies shorter than MEMSET_SMALL are always done a byte at a time, and
+// memcpy copies of at least MEMCPY_STREAM_SIZE bytes use non-temporal stores
+#define MEMCPY_STREAM_SIZE MEMSET_STREAM_SIZE
+
+// copies n bytes from src to dest; the areas must not overlap
+// returns dest
+void *memcpy(void *dest, const void *src, size_t n);
+
+// copies n bytes from src to dest; the areas may overlap
+// returns dest
+void *memmove(void *dest, const void *src, size_t n);
+
+// makes memcpy and memmove use the given MEMSET_* variant, or the fastest
+// supported one if the CPU does not support it
+// returns the variant now in use
+u32int memcpy_use(u32int variant);
+
+#endif // MEMCPY_H
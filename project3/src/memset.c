@@ -1,11 +1,247 @@
 // Memset implementation
 
 #include "memset.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MEMSET_X86
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+// a word that may alias any other type
+typedef size_t __attribute__((may_alias)) memset_word;
+
+// headers for local functions
+void *memset_bytes(void *s, int c, size_t n);
+void *memset_words(void *s, int c, size_t n);
+void *memset_sse2(void *s, int c, size_t n);
+void *memset_avx2(void *s, int c, size_t n);
+u32int memset_xgetbv(void);
+
+// the variant memset uses; NULL until the first fill picks one
+void *(*memset_fill)(void *, int, size_t) = NULL;
+
+// fills one byte at a time
+void *memset_bytes(void *s, int c, size_t n)
+{
+   size_t i;
+
+   for(i = 0; i < n; i++) {
+      ((unsigned char *)s)[i] = c;
+   }
+
+   return s;
+}
+
+// fills one word at a time, with bytes for the unaligned head and tail
+void *memset_words(void *s, int c, size_t n)
+{
+   unsigned char *p = s;
+   size_t word = ((size_t)-1 / 0xff) * (unsigned char)c;
+   size_t head = -(size_t)p & (sizeof(size_t) - 1);
+
+   if(n < head) {
+      head = n;
+   }
+   memset_bytes(p, c, head);
+   p += head;
+   n -= head;
+
+   while(n >= sizeof(size_t))
+   {
+      *(memset_word *)p = word;
+      p += sizeof(size_t);
+      n -= sizeof(size_t);
+   }
+
+   memset_bytes(p, c, n);
+
+   return s;
+}
+
+#ifdef MEMSET_X86
+
+// fills 16 bytes at a time from an aligned address
+// n must be at least MEMSET_SMALL
+__attribute__((target("sse2")))
+void *memset_sse2(void *s, int c, size_t n)
+{
+   unsigned char *p = s;
+   size_t head = -(size_t)p & 15;
+   __m128i fill = _mm_set1_epi8((char)c);
+
+   // one unaligned store covers the head
+   _mm_storeu_si128((__m128i *)p, fill);
+   p += head;
+   n -= head;
+
+   if(n >= MEMSET_STREAM_SIZE)
+   {
+      for(; n >= 64; p += 64, n -= 64)
+      {
+         _mm_stream_si128((__m128i *)p, fill);
+         _mm_stream_si128((__m128i *)(p + 16), fill);
+         _mm_stream_si128((__m128i *)(p + 32), fill);
+         _mm_stream_si128((__m128i *)(p + 48), fill);
+      }
+      _mm_sfence();
+   }
+
+   for(; n >= 64; p += 64, n -= 64)
+   {
+      _mm_store_si128((__m128i *)p, fill);
+      _mm_store_si128((__m128i *)(p + 16), fill);
+      _mm_store_si128((__m128i *)(p + 32), fill);
+      _mm_store_si128((__m128i *)(p + 48), fill);
+   }
+   for(; n >= 16; p += 16, n -= 16) {
+      _mm_store_si128((__m128i *)p, fill);
+   }
+
+   // one unaligned store, ending at the end of the fill, covers the tail
+   if(n > 0) {
+      _mm_storeu_si128((__m128i *)(p + n - 16), fill);
+   }
+
+   return s;
+}
+
+// fills 32 bytes at a time from an aligned address
+// n must be at least MEMSET_SMALL
+__attribute__((target("avx2")))
+void *memset_avx2(void *s, int c, size_t n)
+{
+   unsigned char *p = s;
+   size_t head = -(size_t)p & 31;
+   __m256i fill = _mm256_set1_epi8((char)c);
+
+   // one unaligned store covers the head
+   _mm256_storeu_si256((__m256i *)p, fill);
+   p += head;
+   n -= head;
+
+   if(n >= MEMSET_STREAM_SIZE)
+   {
+      for(; n >= 128; p += 128, n -= 128)
+      {
+         _mm256_stream_si256((__m256i *)p, fill);
+         _mm256_stream_si256((__m256i *)(p + 32), fill);
+         _mm256_stream_si256((__m256i *)(p + 64), fill);
+         _mm256_stream_si256((__m256i *)(p + 96), fill);
+      }
+      _mm_sfence();
+   }
+
+   for(; n >= 128; p += 128, n -= 128)
+   {
+      _mm256_store_si256((__m256i *)p, fill);
+      _mm256_store_si256((__m256i *)(p + 32), fill);
+      _mm256_store_si256((__m256i *)(p + 64), fill);
+      _mm256_store_si256((__m256i *)(p + 96), fill);
+   }
+   for(; n >= 32; p += 32, n -= 32) {
+      _mm256_store_si256((__m256i *)p, fill);
+   }
+
+   // one unaligned store, ending at the end of the fill, covers the tail
+   if(n > 0) {
+      _mm256_storeu_si256((__m256i *)(p + n - 32), fill);
+   }
+
+   return s;
+}
+
+// returns the low word of XCR0, the register state the OS saves on a context
+// switch
+u32int memset_xgetbv(void)
+{
+   u32int eax;
+   u32int edx;
+
+   __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+   return eax;
+}
+
+#else
+
+// without x86 vector registers, the widest fill is a word at a time
+void *memset_sse2(void *s, int c, size_t n)
+{
+   return memset_words(s, c, n);
+}
+
+void *memset_avx2(void *s, int c, size_t n)
+{
+   return memset_words(s, c, n);
+}
+
+#endif // MEMSET_X86
+
+u32int memset_best(void)
+{
+#ifdef MEMSET_X86
+   u32int eax, ebx, ecx, edx;
+   u32int best = MEMSET_WORDS;
+
+   if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+      return best;
+   }
+   if(edx & bit_SSE2) {
+      best = MEMSET_SSE2;
+   }
+
+   // AVX registers are only usable if the OS saves them (XCR0 bits 1 and 2)
+   if((ecx & bit_OSXSAVE) && (ecx & bit_AVX) &&
+      (memset_xgetbv() & 0x6) == 0x6 &&
+      __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2))
+   {
+      best = MEMSET_AVX2;
+   }
+
+   return best;
+#else
+   return MEMSET_WORDS;
+#endif
+}
+
+u32int memset_use(u32int variant)
+{
+   u32int best = memset_best();
+
+   if(variant > best) {
+      variant = best;
+   }
+
+   switch(variant)
+   {
+      case MEMSET_BYTES:
+         memset_fill = &memset_bytes;
+         break;
+      case MEMSET_WORDS:
+         memset_fill = &memset_words;
+         break;
+      case MEMSET_SSE2:
+         memset_fill = &memset_sse2;
+         break;
+      default:
+         memset_fill = &memset_avx2;
+         break;
+   }
+
+   return variant;
+}
+
 void *memset(void *s, int c, size_t n)
 {
-	size_t i = 0;
-	for (i; i < n; i++){
-		((unsigned char *)s)[i] = c;
-	}
-	return s;
+   if(n < MEMSET_SMALL) {
+      return memset_bytes(s, c, n);
+   }
+
+   // several threads may race to pick the variant, but they all pick the same
+   if(memset_fill == NULL) {
+      memset_use(memset_best());
+   }
+
+   return memset_fill(s, c, n);
 }
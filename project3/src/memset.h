@@ -5,7 +5,29 @@
 
 #include "common.h"
 
+// memset fills memory with the widest stores the CPU supports; the variant is
+// picked with CPUID on the first call, and can be overridden with memset_use
+#define MEMSET_BYTES 0 // one byte at a time
+#define MEMSET_WORDS 1 // one machine word at a time
+#define MEMSET_SSE2  2 // 16 bytes at a time
+#define MEMSET_AVX2  3 // 32 bytes at a time
+
+// fills shorter than this are always done a byte at a time
+#define MEMSET_SMALL 32
+
+// fills of at least this many bytes use non-temporal stores, which bypass the
+// cache, so that a large fill does not evict everything else
+#define MEMSET_STREAM_SIZE (4 * 1024 * 1024)
+
 // fills the first n bytes of memory area poitned to by s with c
 void *memset(void *s, int c, size_t n);
 
+// returns the fastest MEMSET_* variant this CPU supports
+u32int memset_best(void);
+
+// makes memset use the given MEMSET_* variant, or the fastest supported one if
+// the CPU does not support it
+// returns the variant now in use
+u32int memset_use(u32int variant);
+
 #endif // MEMSET_H
@@ -0,0 +1,186 @@
+// Regions: bump allocation with bulk release - implementation
+
+#include "region.h"
+
+// headers for local functions
+void *region_align(void *p);
+void region_use(struct region_chunk *chunk, void *next, struct region *region);
+s8int region_grow(size_t size, struct region *region) WARN_UNUSED;
+void region_destroy_children(struct region *region);
+
+// returns p rounded up to a multiple of REGION_ALIGN
+void *region_align(void *p)
+{
+   return (void *)(((size_t)p + REGION_ALIGN - 1) &
+                   ~(size_t)(REGION_ALIGN - 1));
+}
+
+// makes a chunk the one in use, with its next free byte at next
+void region_use(struct region_chunk *chunk, void *next, struct region *region)
+{
+   region->chunk = chunk;
+   region->next = next;
+   region->limit = (void *)chunk + heap_usable_size(chunk);
+}
+
+// takes a new chunk from the heap that holds at least size bytes, and makes
+// it the one in use; whatever was left in the old chunk is not used
+// returns a negative value if the heap is out of space
+s8int region_grow(size_t size, struct region *region)
+{
+   size_t space = sizeof(struct region_chunk) + REGION_ALIGN + size;
+   struct region_chunk *chunk;
+
+   if(space < size) {
+      return -1;
+   }
+   if(space < region->chunk_size) {
+      space = region->chunk_size;
+   }
+
+   chunk = kalloc_heap(space, 0, region->heap);
+   if(chunk == NULL) {
+      return -1;
+   }
+
+   chunk->prev = region->chunk;
+   region_use(chunk, region_align(chunk + 1), region);
+
+   return 0;
+}
+
+// destroys all of the regions nested in a region
+void region_destroy_children(struct region *region)
+{
+   while(region->children != NULL) {
+      region_destroy(region->children);
+   }
+}
+
+struct region *region_create(size_t chunk_size, struct heap *heap)
+{
+   struct region_chunk *chunk;
+   struct region *region;
+
+   if(chunk_size == 0) {
+      chunk_size = REGION_CHUNK_SIZE;
+   }
+
+   // the first chunk holds the region itself
+   if(chunk_size < sizeof(struct region_chunk) + sizeof(struct region)) {
+      chunk_size = sizeof(struct region_chunk) + sizeof(struct region);
+   }
+
+   chunk = kalloc_heap(chunk_size, 0, heap);
+   if(chunk == NULL) {
+      return NULL;
+   }
+   chunk->prev = NULL;
+
+   region = (struct region *)(chunk + 1);
+   region->heap = heap;
+   region->chunk_size = chunk_size;
+   region->parent = NULL;
+   region->children = NULL;
+   region->next_sibling = NULL;
+   region->prev_sibling = NULL;
+
+   region_use(chunk, region_align(region + 1), region);
+   region->start = region_save(region);
+
+   return region;
+}
+
+struct region *region_create_nested(struct region *parent)
+{
+   struct region *region = region_create(parent->chunk_size, parent->heap);
+
+   if(region == NULL) {
+      return NULL;
+   }
+
+   region->parent = parent;
+   region->next_sibling = parent->children;
+   if(parent->children != NULL) {
+      parent->children->prev_sibling = region;
+   }
+   parent->children = region;
+
+   return region;
+}
+
+void *region_alloc(size_t size, struct region *region)
+{
+   void *p = region->next;
+
+   // the common case: the chunk in use has room
+   if(p <= region->limit && size <= (size_t)(region->limit - p))
+   {
+      region->next = region_align(p + size);
+      return p;
+   }
+
+   if(region_grow(size, region) < 0) {
+      return NULL;
+   }
+
+   p = region->next;
+   region->next = region_align(p + size);
+
+   return p;
+}
+
+struct region_mark region_save(struct region *region)
+{
+   struct region_mark mark;
+
+   mark.chunk = region->chunk;
+   mark.next = region->next;
+
+   return mark;
+}
+
+void region_rollback(struct region_mark mark, struct region *region)
+{
+   // chunks are only ever added in front, so every chunk taken since the save
+   // point is in front of the chunk that was in use then
+   while(region->chunk != mark.chunk)
+   {
+      struct region_chunk *prev = region->chunk->prev;
+
+      kfree_heap(region->chunk, region->heap);
+      region->chunk = prev;
+   }
+
+   region_use(mark.chunk, mark.next, region);
+}
+
+void region_reset(struct region *region)
+{
+   region_destroy_children(region);
+   region_rollback(region->start, region);
+}
+
+void region_destroy(struct region *region)
+{
+   struct region_chunk *first = region->start.chunk;
+
+   region_destroy_children(region);
+
+   if(region->parent != NULL)
+   {
+      if(region->prev_sibling != NULL) {
+         region->prev_sibling->next_sibling = region->next_sibling;
+      }
+      else {
+         region->parent->children = region->next_sibling;
+      }
+      if(region->next_sibling != NULL) {
+         region->next_sibling->prev_sibling = region->prev_sibling;
+      }
+   }
+
+   // the region itself is in the first chunk, so that chunk goes last
+   region_rollback(region->start, region);
+   kfree_heap(first, region->heap);
+}
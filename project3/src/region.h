@@ -0,0 +1,87 @@
+// Regions: bump allocation with bulk release, layered on a heap
+
+#ifndef REGION_H
+#define REGION_H
+
+#include "common.h"
+#include "kheap.h"
+
+// a region takes large chunks from the heap with kalloc_heap and hands out
+// memory from the current chunk by bumping a pointer; objects have no header
+// and cannot be freed one by one. Everything is released at once, with
+// region_reset (keeping the region) or region_destroy
+//
+// a region created inside another one (region_create_nested) is destroyed
+// along with its parent, when the parent is reset or destroyed. A save point
+// from region_save marks how far a region has been used; region_rollback
+// releases everything allocated in the region since then
+//
+// regions are not thread-safe
+
+// allocations are aligned to REGION_ALIGN bytes
+#define REGION_ALIGN      16
+
+// the default size of a chunk, including the region's chunk header
+#define REGION_CHUNK_SIZE (16 * 1024)
+
+// a chunk of memory from the heap, stored at the start of the chunk
+struct region_chunk
+{
+   struct region_chunk *prev; // the chunk that was in use before this one
+};
+
+// a save point in a region
+struct region_mark
+{
+   struct region_chunk *chunk; // the chunk in use
+   void *next;                 // the next free byte in it
+};
+
+// the main region struct, stored in the region's first chunk
+struct region
+{
+   struct heap *heap;          // where chunks come from
+   size_t chunk_size;          // the size of each chunk
+   struct region_chunk *chunk; // the chunk in use; its prev links lead back
+                               // to the first chunk
+   void *next;                 // the next free byte in the chunk in use
+   void *limit;                // the end of the chunk in use
+   struct region_mark start;   // the first free byte in the first chunk
+   struct region *parent;      // the region this one is nested in, or NULL
+   struct region *children;    // regions nested in this one
+   struct region *next_sibling;
+   struct region *prev_sibling;
+};
+
+// creates a region whose chunks come from the heap
+// chunk_size is the size of each chunk (0 means REGION_CHUNK_SIZE);
+// allocations larger than a chunk get a chunk of their own
+// returns NULL if the first chunk cannot be allocated
+struct region *region_create(size_t chunk_size, struct heap *heap);
+
+// creates a region nested in another one, with the same heap and chunk size
+// the nested region is destroyed when its parent is reset or destroyed
+// returns NULL if the first chunk cannot be allocated
+struct region *region_create_nested(struct region *parent);
+
+// allocates size bytes from a region
+// returns NULL if a new chunk is needed and the heap cannot supply one
+void *region_alloc(size_t size, struct region *region);
+
+// returns a save point for the region's current state
+struct region_mark region_save(struct region *region);
+
+// releases everything allocated in a region since the save point was taken;
+// chunks taken since then go back to the heap
+// regions nested in the region are not affected
+void region_rollback(struct region_mark mark, struct region *region);
+
+// releases everything allocated in a region, and destroys the regions nested
+// in it; the region keeps its first chunk and can be used again
+void region_reset(struct region *region);
+
+// releases everything allocated in a region, destroys the regions nested in
+// it, and gives all of its chunks back to the heap
+void region_destroy(struct region *region);
+
+#endif // REGION_H
@@ -0,0 +1,198 @@
+// Object caches for fixed-size objects - implementation
+
+#include "slab.h"
+
+// headers for local functions
+size_t slab_round_up(size_t n, size_t align);
+void slab_link(struct slab *slab, struct slab **list);
+void slab_unlink(struct slab *slab, struct slab **list);
+struct slab *slab_grow(struct slab_cache *cache);
+
+// returns n rounded up to a multiple of align, which is a power of two
+size_t slab_round_up(size_t n, size_t align)
+{
+   return (n + align - 1) & ~(align - 1);
+}
+
+// pushes a slab onto the front of a list
+void slab_link(struct slab *slab, struct slab **list)
+{
+   slab->prev = NULL;
+   slab->next = *list;
+   if(*list != NULL) {
+      (*list)->prev = slab;
+   }
+   *list = slab;
+}
+
+// takes a slab out of a list
+void slab_unlink(struct slab *slab, struct slab **list)
+{
+   if(slab->prev != NULL) {
+      slab->prev->next = slab->next;
+   }
+   else {
+      *list = slab->next;
+   }
+   if(slab->next != NULL) {
+      slab->next->prev = slab->prev;
+   }
+}
+
+// takes a new slab from the heap and adds it to the partial list
+// returns NULL if the heap is out of space
+struct slab *slab_grow(struct slab_cache *cache)
+{
+   struct slab *slab = kalloc_heap(SLAB_SPACE, 1, cache->heap);
+
+   if(slab == NULL) {
+      return NULL;
+   }
+
+   // objects are handed out in address order from unused until the slab has
+   // been used up once, so nothing needs to be threaded onto the free list yet
+   slab->cache = cache;
+   slab->free = NULL;
+   slab->unused = (void *)slab + cache->first_object;
+   slab->in_use = 0;
+
+   slab_link(slab, &cache->partial);
+   cache->slabs++;
+
+   return slab;
+}
+
+struct slab_cache *slab_cache_create(size_t size,
+                                     size_t align,
+                                     struct heap *heap)
+{
+   struct slab_cache *cache;
+
+   if(align == 0) {
+      align = sizeof(void *);
+   }
+   if((align & (align - 1)) != 0) {
+      return NULL;
+   }
+
+   // free objects hold the free list link
+   if(size < sizeof(void *)) {
+      size = sizeof(void *);
+   }
+   size = slab_round_up(size, align);
+
+   // at least one object has to fit after the slab struct
+   if(slab_round_up(sizeof(struct slab), align) + size > SLAB_SPACE) {
+      return NULL;
+   }
+
+   cache = kalloc_heap(sizeof(struct slab_cache), 0, heap);
+   if(cache == NULL) {
+      return NULL;
+   }
+
+   cache->heap = heap;
+   cache->object_size = size;
+   cache->align = align;
+   cache->first_object = slab_round_up(sizeof(struct slab), align);
+   cache->per_slab = (SLAB_SPACE - cache->first_object) / size;
+   cache->partial = NULL;
+   cache->full = NULL;
+   cache->slabs = 0;
+
+   return cache;
+}
+
+void *slab_alloc(struct slab_cache *cache)
+{
+   struct slab *slab = cache->partial;
+   void *p;
+
+   if(slab == NULL)
+   {
+      slab = slab_grow(cache);
+      if(slab == NULL) {
+         return NULL;
+      }
+   }
+
+   // reuse freed objects first, then carry on through the unused ones
+   if(slab->free != NULL)
+   {
+      p = slab->free;
+      slab->free = *(void **)p;
+   }
+   else
+   {
+      p = slab->unused;
+      slab->unused += cache->object_size;
+   }
+
+   slab->in_use++;
+   if(slab->in_use == cache->per_slab)
+   {
+      slab_unlink(slab, &cache->partial);
+      slab_link(slab, &cache->full);
+   }
+
+   return p;
+}
+
+void slab_free(void *p, struct slab_cache *cache)
+{
+   struct slab *slab;
+
+   if(p == NULL) {
+      return;
+   }
+
+   slab = (struct slab *)((size_t)p & PAGE_MASK);
+   if(slab->cache != cache) {
+      return;
+   }
+
+   // a full slab has space again
+   if(slab->in_use == cache->per_slab)
+   {
+      slab_unlink(slab, &cache->full);
+      slab_link(slab, &cache->partial);
+   }
+
+   *(void **)p = slab->free;
+   slab->free = p;
+   slab->in_use--;
+
+   // give empty slabs back to the heap, but keep the last one so that a
+   // cache that goes back and forth around a slab boundary does not keep
+   // asking the heap for pages
+   if(slab->in_use == 0 && (slab->next != NULL || slab->prev != NULL))
+   {
+      slab_unlink(slab, &cache->partial);
+      slab->cache = NULL;
+      kfree_heap(slab, cache->heap);
+      cache->slabs--;
+   }
+}
+
+void slab_cache_destroy(struct slab_cache *cache)
+{
+   struct slab **lists[2];
+   int i;
+
+   lists[0] = &cache->partial;
+   lists[1] = &cache->full;
+
+   for(i = 0; i < 2; i++)
+   {
+      while(*lists[i] != NULL)
+      {
+         struct slab *slab = *lists[i];
+
+         slab_unlink(slab, lists[i]);
+         slab->cache = NULL;
+         kfree_heap(slab, cache->heap);
+      }
+   }
+
+   kfree_heap(cache, cache->heap);
+}
@@ -0,0 +1,67 @@
+// Object caches for fixed-size objects, layered on a heap
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include "common.h"
+#include "kheap.h"
+
+// a cache hands out objects of one size from slabs: page-aligned, one page
+// blocks taken from the heap with kalloc_heap(..., 1, heap). Objects have no
+// header or footer of their own; free objects are kept in a list threaded
+// through the objects themselves, and the slab an object belongs to is found
+// by rounding its address down to the page
+//
+// each slab block is sized so that its metadata and the next block's header
+// fit in the last bytes of the page, so consecutive slabs sit in consecutive
+// pages of the heap
+//
+// caches are not thread-safe
+
+// the space in a slab page, after the heap's metadata for the next block
+#define SLAB_SPACE (PAGE_SIZE - HEAP_BLOCK_OVERHEAD)
+
+// a slab, stored at the start of its page
+struct slab
+{
+   struct slab *next;          // the next slab in the cache's list
+   struct slab *prev;          // the previous slab in the cache's list
+   struct slab_cache *cache;   // the cache that owns the slab
+   void *free;                 // freed objects
+   void *unused;               // the first object that was never handed out
+   size_t in_use;              // the number of objects handed out
+};
+
+// the main object cache struct
+struct slab_cache
+{
+   struct heap *heap;     // where slabs come from
+   size_t object_size;    // the size of each object, including padding
+   size_t align;          // the alignment of each object
+   size_t first_object;   // the offset of the first object in a slab
+   size_t per_slab;       // the number of objects in each slab
+   struct slab *partial;  // slabs with free objects
+   struct slab *full;     // slabs with no free objects
+   size_t slabs;          // the number of slabs in the cache
+};
+
+// creates a cache for objects of the given size and alignment
+// align must be a power of two (0 means pointer alignment)
+// returns NULL if a slab cannot hold an object of this size, or if the cache
+// cannot be allocated from the heap
+struct slab_cache *slab_cache_create(size_t size,
+                                     size_t align,
+                                     struct heap *heap);
+
+// allocates an object from a cache
+// returns NULL if the heap cannot supply a new slab
+void *slab_alloc(struct slab_cache *cache);
+
+// returns an object to its cache
+void slab_free(void *p, struct slab_cache *cache);
+
+// gives all of a cache's slabs, and the cache itself, back to the heap
+// objects still in use are released along with their slabs
+void slab_cache_destroy(struct slab_cache *cache);
+
+#endif // SLAB_H
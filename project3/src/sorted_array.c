@@ -2,7 +2,7 @@
 
 #include "sorted_array.h"
 
-#include "memset.h"
+#include "memcpy.h"
 
 struct sorted_array sorted_array_place(void *addr,
                                        size_t max_size,
@@ -11,9 +11,9 @@ struct sorted_array sorted_array_place(void *addr,
    // the array to return
    struct sorted_array array;
 
-   // set the pointer to the memory to use and clear the memory
+   // set the pointer to the memory to use; entries past the size are never
+   // read, so the memory is only written as items are added
    array.storage = addr;
-   memset(array.storage, 0, max_size * sizeof(void *));
 
    // set the size, max size, and comparison function
    array.size = 0;
@@ -23,47 +23,62 @@ struct sorted_array sorted_array_place(void *addr,
    return array;
 }
 
-void sorted_array_insert(void *item, struct sorted_array *array)
+s8int sorted_array_insert(void *item, struct sorted_array *array)
 {
-   // iterator counter
-   size_t i = 0;
+   // the slot the item goes in
+   size_t i;
 
-   // FIXME: max size check before doing anything
-
-   // traverse while the current item is less than the item being inserted, or
-   // the end is reached
-   while(i < array->size && array->comparison(array->storage[i], item) < 0) {
-       i++;
+   // there has to be room for one more item
+   if(array->size >= array->max_size) {
+      return -1;
    }
 
-   // ended iteration - at the end of the sorted array
-   if(i == array->size)
-   {
-      // at the end of the array - add at the end of the array
-      array->storage[array->size++] = item;
-   }
-   else
+   // the item goes after everything that comes before it, and before
+   // everything else
+   i = sorted_array_lower_bound(item, array->comparison, array);
+
+   // move everything from the slot on down by one
+   memmove(&array->storage[i + 1], &array->storage[i],
+           (array->size - i) * sizeof(void *));
+   array->storage[i] = item;
+   array->size++;
+
+   return 0;
+}
+
+size_t sorted_array_lower_bound(void *key,
+                                comparison_predicate_t comparison,
+                                struct sorted_array *array)
+{
+   size_t low = 0;
+   size_t high = array->size;
+
+   // everything before low comes before the key, and nothing from high on
+   // does
+   while(low < high)
    {
-      // somewhere in the middle
-      // move all elements after this element
-
-      // the current element in this slot
-      void *tmp = array->storage[i];
-
-      // put the item being inserted into the slot
-      array->storage[i] = item;
-
-      // shift everything after the current elemtn down by one
-      while(i < array->size)
-      {
-         i++;
-         void *tmp2 = array->storage[i];
-         array->storage[i] = tmp;
-         tmp = tmp2;
+      size_t middle = low + (high - low) / 2;
+
+      if(comparison(array->storage[middle], key) < 0) {
+         low = middle + 1;
       }
+      else {
+         high = middle;
+      }
+   }
 
-      array->size++;
+   return low;
+}
+
+size_t sorted_array_search(void *item, struct sorted_array *array)
+{
+   size_t i = sorted_array_lower_bound(item, array->comparison, array);
+
+   if(i < array->size && array->comparison(array->storage[i], item) == 0) {
+      return i;
    }
+
+   return array->size;
 }
 
 void *sorted_array_lookup(size_t i, struct sorted_array *array)
@@ -81,10 +96,8 @@ void sorted_array_remove(size_t i, struct sorted_array *array)
       return;
    }
 
-   while (i < array->size)
-   {
-       array->storage[i] = array->storage[i+1];
-       i++;
-   }
+   // move everything after the item up by one
+   memmove(&array->storage[i], &array->storage[i + 1],
+           (array->size - i - 1) * sizeof(void *));
    array->size--;
 }
@@ -27,6 +27,8 @@ struct sorted_array sorted_array_create(size_t max_size,
 
 // places a sorted array of a maximum size with a particular comparison
 // function at the specified memory address
+// the memory does not have to be cleared, and is not touched until items are
+// added
 struct sorted_array sorted_array_place(void *addr,
                                        size_t max_size,
                                        comparison_predicate_t comparison);
@@ -34,7 +36,24 @@ struct sorted_array sorted_array_place(void *addr,
 void sorted_array_destroy(struct sorted_array *array);
 
 // adds an item to the array
-void sorted_array_insert(void *item, struct sorted_array *array);
+// returns a negative value if the array is already at its maximum size, in
+// which case the item is not added; 0 on success
+s8int sorted_array_insert(void *item, struct sorted_array *array);
+
+// returns the index of the first item that does not come before key, or the
+// size of the array if every item comes before it
+// comparison is called with an item and the key, and returns -1 if the item
+// comes before the key; it has to agree with the array's own order, but the
+// key does not have to be an item (e.g. it can be just the field the items
+// are sorted by)
+size_t sorted_array_lower_bound(void *key,
+                                comparison_predicate_t comparison,
+                                struct sorted_array *array);
+
+// returns the index of the item that compares equal to item, or the size of
+// the array if there is none; this is a binary search, so the comparison
+// function should be a total order that only finds an item equal to itself
+size_t sorted_array_search(void *item, struct sorted_array *array);
 
 // returns the item at index i
 // if the index is invalid, NULL is returned
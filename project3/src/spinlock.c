@@ -0,0 +1,50 @@
+// A simple spinlock - implementation
+
+#include "spinlock.h"
+
+#include <sched.h>
+
+// tells the CPU that it is in a spin-wait loop; elsewhere than on x86, the
+// loop just spins
+#if defined(__x86_64__) || defined(__i386__)
+#define SPINLOCK_PAUSE() __builtin_ia32_pause()
+#else
+#define SPINLOCK_PAUSE()
+#endif
+
+void spinlock_init(struct spinlock *lock)
+{
+   __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+void spinlock_acquire(struct spinlock *lock)
+{
+   u32int spins = 0;
+
+   while(!spinlock_try_acquire(lock))
+   {
+      // wait for the lock to look free before trying again, so that waiters
+      // do not keep stealing the cache line from the holder
+      while(__atomic_load_n(&lock->locked, __ATOMIC_RELAXED))
+      {
+         if(++spins < SPINLOCK_SPINS) {
+            SPINLOCK_PAUSE();
+         }
+         else {
+            // the holder has probably been preempted
+            sched_yield();
+            spins = 0;
+         }
+      }
+   }
+}
+
+u8int spinlock_try_acquire(struct spinlock *lock)
+{
+   return __atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE) == 0;
+}
+
+void spinlock_release(struct spinlock *lock)
+{
+   __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
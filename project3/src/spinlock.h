@@ -0,0 +1,30 @@
+// A simple spinlock
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "common.h"
+
+// the number of times to spin on a held lock before yielding the CPU
+#define SPINLOCK_SPINS 100
+
+// the main spinlock struct
+struct spinlock
+{
+   volatile u32int locked; // 1 if held; 0 if free
+};
+
+// initialises a lock to the unlocked state
+void spinlock_init(struct spinlock *lock);
+
+// acquires a lock, waiting until it is free
+void spinlock_acquire(struct spinlock *lock);
+
+// tries to acquire a lock without waiting
+// returns 1 if the lock was acquired, 0 if it is held by someone else
+u8int spinlock_try_acquire(struct spinlock *lock);
+
+// releases a lock that is held by the caller
+void spinlock_release(struct spinlock *lock);
+
+#endif // SPINLOCK_H
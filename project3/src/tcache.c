@@ -0,0 +1,216 @@
+// Thread-safe heap calls with per-thread caches of small blocks -
+// implementation
+
+#include "tcache.h"
+
+#include <pthread.h>
+
+// the calling thread's cache
+__thread struct tcache thread_cache;
+
+// a thread-specific key whose destructor flushes an exiting thread's cache;
+// a thread sets it the first time it uses its cache
+pthread_key_t tcache_key;
+pthread_once_t tcache_key_once = PTHREAD_ONCE_INIT;
+
+// headers for local functions
+void tcache_refill(size_t bin, struct tcache *cache);
+void tcache_flush_bin(size_t bin, u32int keep, struct tcache *cache);
+void tcache_bind(struct heap *heap, struct tcache *cache);
+void tcache_adopt(struct heap *heap, struct tcache *cache);
+void tcache_create_key(void);
+void tcache_exit(void *cache);
+
+// takes a batch of blocks for a bin from the heap
+void tcache_refill(size_t bin, struct tcache *cache)
+{
+   size_t sizes[TCACHE_BATCH];
+   void *batch[TCACHE_BATCH];
+   u32int count = TCACHE_BATCH;
+   u32int i;
+
+   for(i = 0; i < TCACHE_BATCH; i++) {
+      sizes[i] = (bin + 1) * TCACHE_SPACING;
+   }
+
+   spinlock_acquire(&cache->heap->lock);
+   if(kalloc_heap_batch(TCACHE_BATCH, sizes, batch, cache->heap) < 0)
+   {
+      // the heap is nearly full; take a single block if there is one
+      batch[0] = kalloc_heap(sizes[0], 0, cache->heap);
+      count = (batch[0] != NULL);
+   }
+   spinlock_release(&cache->heap->lock);
+
+   for(i = 0; i < count; i++)
+   {
+      *(void **)batch[i] = cache->bins[bin];
+      cache->bins[bin] = batch[i];
+      cache->counts[bin]++;
+   }
+
+   cache->refills++;
+}
+
+// gives the blocks in a bin back to the heap until only keep are left
+void tcache_flush_bin(size_t bin, u32int keep, struct tcache *cache)
+{
+   void *batch[TCACHE_BIN_MAX + 1];
+   size_t n;
+
+   spinlock_acquire(&cache->heap->lock);
+   while(cache->counts[bin] > keep)
+   {
+      n = 0;
+      while(cache->counts[bin] > keep && n < TCACHE_BIN_MAX + 1)
+      {
+         batch[n++] = cache->bins[bin];
+         cache->bins[bin] = *(void **)batch[n - 1];
+         cache->counts[bin]--;
+      }
+
+      kfree_heap_batch(batch, n, cache->heap);
+   }
+   spinlock_release(&cache->heap->lock);
+
+   cache->flushes++;
+}
+
+// makes the cache belong to the given heap, flushing it if it belonged to
+// another one
+void tcache_bind(struct heap *heap, struct tcache *cache)
+{
+   if(cache->heap == NULL) {
+      tcache_adopt(heap, cache);
+   }
+   else if(cache->heap != heap)
+   {
+      tcache_flush();
+      cache->heap = heap;
+   }
+}
+
+// makes an unused cache belong to the given heap, and arranges for it to be
+// flushed when the thread exits
+void tcache_adopt(struct heap *heap, struct tcache *cache)
+{
+   pthread_once(&tcache_key_once, &tcache_create_key);
+
+   // the destructor only runs for a key with a value other than NULL
+   pthread_setspecific(tcache_key, cache);
+   cache->heap = heap;
+}
+
+// creates the key whose destructor flushes a thread's cache
+void tcache_create_key(void)
+{
+   pthread_key_create(&tcache_key, &tcache_exit);
+}
+
+// flushes the cache of a thread that is exiting
+void tcache_exit(void *cache)
+{
+   tcache_flush();
+}
+
+void *kalloc_heap_mt(size_t size, u8int page_align, struct heap *heap)
+{
+   struct tcache *cache = &thread_cache;
+   size_t bin;
+   void *p;
+
+   // aligned and large requests go straight to the heap
+   if(page_align || size == 0 || size > TCACHE_MAX_SIZE)
+   {
+      spinlock_acquire(&heap->lock);
+      p = kalloc_heap(size, page_align, heap);
+      spinlock_release(&heap->lock);
+
+      return p;
+   }
+
+   tcache_bind(heap, cache);
+
+   // the smallest bin whose blocks are all large enough
+   bin = (size - 1) / TCACHE_SPACING;
+   if(cache->bins[bin] == NULL)
+   {
+      tcache_refill(bin, cache);
+      if(cache->bins[bin] == NULL) {
+         // the heap is full
+         return NULL;
+      }
+   }
+   else
+   {
+      cache->hits++;
+   }
+
+   p = cache->bins[bin];
+   cache->bins[bin] = *(void **)p;
+   cache->counts[bin]--;
+
+   return p;
+}
+
+void kfree_heap_mt(void *p, struct heap *heap)
+{
+   struct tcache *cache = &thread_cache;
+   size_t space;
+   size_t bin;
+
+   if(p == NULL) {
+      return;
+   }
+
+   // a thread that has not allocated yet adopts the heap it frees to
+   if(cache->heap == NULL) {
+      tcache_adopt(heap, cache);
+   }
+
+   // blocks from another heap, and blocks that are too large or too small for
+   // the cache, go straight back to the heap
+   space = heap_usable_size(p);
+   if(cache->heap != heap || space < TCACHE_SPACING ||
+      space >= TCACHE_MAX_SIZE + TCACHE_SPACING)
+   {
+      spinlock_acquire(&heap->lock);
+      kfree_heap(p, heap);
+      spinlock_release(&heap->lock);
+
+      return;
+   }
+
+   // the largest bin that the block is big enough for
+   bin = space / TCACHE_SPACING - 1;
+
+   *(void **)p = cache->bins[bin];
+   cache->bins[bin] = p;
+   cache->counts[bin]++;
+
+   if(cache->counts[bin] > TCACHE_BIN_MAX) {
+      tcache_flush_bin(bin, TCACHE_BATCH, cache);
+   }
+}
+
+void tcache_flush(void)
+{
+   struct tcache *cache = &thread_cache;
+   size_t bin;
+
+   if(cache->heap == NULL) {
+      return;
+   }
+
+   for(bin = 0; bin < TCACHE_BIN_COUNT; bin++)
+   {
+      if(cache->counts[bin] > 0) {
+         tcache_flush_bin(bin, 0, cache);
+      }
+   }
+}
+
+struct tcache *tcache_self(void)
+{
+   return &thread_cache;
+}
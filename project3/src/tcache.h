@@ -0,0 +1,54 @@
+// Thread-safe heap calls with per-thread caches of small blocks
+
+#ifndef TCACHE_H
+#define TCACHE_H
+
+#include "common.h"
+#include "kheap.h"
+
+// each thread keeps a cache of recently freed small blocks, binned by size,
+// in front of the shared heap. Cached blocks stay allocated as far as the heap
+// is concerned, so most small allocations and frees never take the heap's
+// lock; a thread only goes to the heap to refill an empty bin or to flush a
+// full one, and then moves TCACHE_BATCH blocks under a single lock
+// acquisition
+//
+// a thread's cache belongs to one heap at a time; using another heap flushes
+// it first. A thread's cache is flushed when the thread exits
+
+// cache bin i holds blocks with at least (i + 1) * TCACHE_SPACING bytes of
+// space; larger requests go straight to the heap
+#define TCACHE_BIN_COUNT 32
+#define TCACHE_SPACING   16
+#define TCACHE_MAX_SIZE  (TCACHE_BIN_COUNT * TCACHE_SPACING)
+
+// the number of blocks moved between a cache bin and the heap at once
+#define TCACHE_BATCH     8
+
+// a bin holding more than this many blocks is flushed down to TCACHE_BATCH
+#define TCACHE_BIN_MAX   (2 * TCACHE_BATCH)
+
+// a thread's cache
+struct tcache
+{
+   struct heap *heap;                 // the heap the cached blocks belong to
+   void *bins[TCACHE_BIN_COUNT];      // lists threaded through the blocks
+   u32int counts[TCACHE_BIN_COUNT];   // the number of blocks in each bin
+   size_t hits;                       // allocations served from the cache
+   size_t refills;                    // batches taken from the heap
+   size_t flushes;                    // batches given back to the heap
+};
+
+// allocates memory, as kalloc_heap, from a heap shared between threads
+void *kalloc_heap_mt(size_t size, u8int page_align, struct heap *heap);
+
+// releases memory, as kfree_heap, to a heap shared between threads
+void kfree_heap_mt(void *p, struct heap *heap);
+
+// gives all of the calling thread's cached blocks back to their heap
+void tcache_flush(void);
+
+// returns the calling thread's cache
+struct tcache *tcache_self(void);
+
+#endif // TCACHE_H
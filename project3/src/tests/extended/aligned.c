@@ -0,0 +1,103 @@
+// REQUIRED-5: aligned allocations: any power-of-two alignment, in every mode
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define ALLOCATIONS         64
+
+size_t alignments[] = { 1, 16, 64, 256, PAGE_SIZE, 2 * 1024 * 1024 };
+u32int modes[] = { 0, HEAP_FREE_TREE, HEAP_SEGREGATED,
+                   HEAP_FREE_TREE | HEAP_SEGREGATED };
+
+// returns the number of holes in the heap's indexes
+size_t indexed_holes(struct heap *heap)
+{
+   size_t holes;
+   size_t i;
+
+   holes = (heap->flags & HEAP_FREE_TREE) ? heap->free_tree.size :
+                                            heap->free_list.size;
+   for(i = 0; i < HEAP_BIN_COUNT; i++) {
+      holes += heap->bins[i].holes;
+   }
+
+   return holes;
+}
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   void *allocated[ALLOCATIONS];
+   struct heap_stats stats;
+   size_t mode;
+   size_t a;
+   int i;
+
+   for(mode = 0; mode < sizeof(modes) / sizeof(modes[0]); mode++)
+   {
+      struct heap *heap = heap_create_flags(space,
+                                            space + SPACE_SIZE_INITIAL,
+                                            space + SPACE_SIZE_TOTAL,
+                                            modes[mode]);
+      void *small;
+
+      t_assert("An alignment that is not a power of two should be refused",
+               kalloc_heap_aligned(100, 48, heap) == NULL &&
+               kalloc_heap_aligned(100, 0, heap) == NULL);
+
+      // the space skipped to align the block is a hole that the next
+      // allocation can use
+      allocated[0] = kalloc_heap_aligned(100, PAGE_SIZE, heap);
+      small = kalloc_heap(100, 0, heap);
+      t_assert("The skipped space should be reused",
+               small != NULL && small < allocated[0]);
+      kfree_heap(small, heap);
+      kfree_heap(allocated[0], heap);
+
+      for(a = 0; a < sizeof(alignments) / sizeof(alignments[0]); a++)
+      {
+         size_t alignment = alignments[a];
+         int count = (alignment > PAGE_SIZE) ? 2 : ALLOCATIONS;
+
+         for(i = 0; i < count; i++)
+         {
+            size_t size = 1 + (i * 37) % 500;
+
+            allocated[i] = kalloc_heap_aligned(size, alignment, heap);
+            t_assert("The allocation should succeed", allocated[i] != NULL);
+            t_assert("The block should be aligned",
+                     ((size_t)allocated[i] & (alignment - 1)) == 0);
+            t_assert("The block should hold the size asked for",
+                     heap_usable_size(allocated[i]) >= size);
+            memset(allocated[i], 0xa5, size);
+         }
+
+         heap_stats(heap, &stats);
+         t_assert("Every hole should be indexed",
+                  stats.holes == indexed_holes(heap));
+
+         for(i = 0; i < count; i += 2) {
+            kfree_heap(allocated[i], heap);
+         }
+         for(i = 1; i < count; i += 2) {
+            kfree_heap(allocated[i], heap);
+         }
+
+         heap_stats(heap, &stats);
+         t_assert("Freeing every block should leave one hole",
+                  stats.blocks == 0 && stats.holes == 1 &&
+                  indexed_holes(heap) == 1);
+      }
+   }
+
+   free(space);
+
+   return 0;
+}
@@ -0,0 +1,105 @@
+// REQUIRED-10: arenas: threads get their own heaps and frees are routed back
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "../test.h"
+#include "../../arena.h"
+
+#define SPACE_SIZE_INITIAL  (8 * 1024 * 1024)   // 8MiB
+#define SPACE_SIZE_TOTAL    (16 * 1024 * 1024)  // 16MiB
+
+#define ARENAS              4
+#define ALLOCATIONS         500
+
+struct arenas *arenas;
+
+// the blocks each thread allocated, freed later by the main thread
+void *blocks[ARENAS][ALLOCATIONS];
+
+// allocates blocks, checking that they all come from the thread's home arena
+void *worker(void *arg)
+{
+   size_t id = (size_t)arg;
+   struct heap *home = arenas->heaps[arena_home(arenas)];
+   int i;
+
+   for(i = 0; i < ALLOCATIONS; i++)
+   {
+      blocks[id][i] = kalloc_arena(16 + i % 200, 0, arenas);
+      if(blocks[id][i] == NULL || arena_owner(blocks[id][i], arenas) != home) {
+         return (void *)1;
+      }
+
+      // free some of them straight away
+      if(i % 3 == 0)
+      {
+         kfree_arena(blocks[id][i], arenas);
+         blocks[id][i] = NULL;
+      }
+   }
+
+   return NULL;
+}
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   pthread_t threads[ARENAS];
+   void *result;
+   size_t i;
+   int j;
+
+   // create the arenas
+   arenas = arenas_create(space,
+                          space + SPACE_SIZE_INITIAL,
+                          space + SPACE_SIZE_TOTAL,
+                          ARENAS,
+                          ARENA_ROUND_ROBIN,
+                          HEAP_FREE_TREE);
+   t_assert("The arenas should be created", arenas != NULL);
+   t_assert("The arenas should be page-aligned",
+            ((size_t)arenas->heaps[0] & ~PAGE_MASK) == 0 &&
+            ((size_t)arenas->heaps[1] & ~PAGE_MASK) == 0);
+
+   // pointers outside of the arenas have no owner
+   t_assert("A pointer outside of the arenas should have no owner",
+            arena_owner(space + SPACE_SIZE_TOTAL, arenas) == NULL);
+
+   // round robin: each thread gets a different arena
+   for(i = 0; i < ARENAS; i++) {
+      pthread_create(&threads[i], NULL, worker, (void *)i);
+   }
+   for(i = 0; i < ARENAS; i++)
+   {
+      pthread_join(threads[i], &result);
+      t_assert("Each thread should allocate from its home arena",
+               result == NULL);
+   }
+   for(i = 1; i < ARENAS; i++)
+   {
+      t_assert("The threads should have been spread over the arenas",
+               arena_owner(blocks[i][1], arenas) !=
+               arena_owner(blocks[i - 1][1], arenas));
+   }
+
+   // the main thread frees everything the workers left, whichever arena it
+   // came from
+   for(i = 0; i < ARENAS; i++)
+   {
+      for(j = 0; j < ALLOCATIONS; j++) {
+         kfree_arena(blocks[i][j], arenas);
+      }
+   }
+   for(i = 0; i < ARENAS; i++)
+   {
+      t_assert("Every arena should be one hole again",
+               arenas->heaps[i]->free_tree.size == 1);
+   }
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
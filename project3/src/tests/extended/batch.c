@@ -0,0 +1,95 @@
+// REQUIRED-10: batch allocation carves one hole, batch free coalesces in a pass
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define BATCH               12
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   size_t sizes[BATCH];
+   void *out[BATCH];
+   void *ptrs[BATCH + 2];
+   int i;
+
+   // create the heap
+   struct heap *heap = heap_create(space,
+                                   space + SPACE_SIZE_INITIAL,
+                                   space + SPACE_SIZE_TOTAL);
+
+   for(i = 0; i < BATCH; i++) {
+      sizes[i] = 10 + 17 * i;
+   }
+
+   t_assert("The batch allocation should succeed",
+            kalloc_heap_batch(BATCH, sizes, out, heap) == 0);
+   t_assert("The rest of the hole should be the only hole",
+            heap->free_list.size == 1);
+
+   for(i = 0; i < BATCH; i++)
+   {
+      t_assert("Each block should be large enough",
+               heap_usable_size(out[i]) >= sizes[i]);
+      *(int *)out[i] = i;
+   }
+   for(i = 1; i < BATCH; i++)
+   {
+      t_assert("The blocks should be carved one after the other",
+               out[i] == out[i - 1] + heap_usable_size(out[i - 1]) +
+                         HEAP_BLOCK_OVERHEAD);
+   }
+
+   // the blocks behave as blocks from kalloc_heap
+   kfree_heap(out[BATCH - 1], heap);
+   for(i = 0; i < BATCH - 1; i++)
+   {
+      t_assert("The blocks should not have been overwritten",
+               *(int *)out[i] == i);
+   }
+   out[BATCH - 1] = kalloc_heap(sizes[BATCH - 1], 0, heap);
+
+   // free out of order, with a NULL and a repeat, keeping one block in use so
+   // that two runs are coalesced
+   for(i = 0; i < BATCH; i++) {
+      ptrs[i] = out[(i * 5) % BATCH];
+   }
+   ptrs[BATCH] = NULL;
+   ptrs[BATCH + 1] = out[0];
+   for(i = 0; i < BATCH + 2; i++)
+   {
+      if(ptrs[i] == out[4]) {
+         ptrs[i] = NULL;
+      }
+   }
+
+   kfree_heap_batch(ptrs, BATCH + 2, heap);
+   t_assert("The pointers should be sorted by address",
+            ptrs[0] <= ptrs[1] && ptrs[BATCH] <= ptrs[BATCH + 1]);
+   t_assert("The blocks before the one in use should be one hole, and the "
+            "blocks after it should coalesce with the rest of the heap",
+            heap->free_list.size == 2);
+   t_assert("The block in use should be intact", *(int *)out[4] == 4);
+
+   kfree_heap_batch(&out[4], 1, heap);
+   t_assert("Everything should coalesce into one hole",
+            heap->free_list.size == 1);
+
+   // a batch larger than the heap fails as a whole
+   sizes[BATCH - 1] = SPACE_SIZE_TOTAL;
+   t_assert("A batch that does not fit should fail",
+            kalloc_heap_batch(BATCH, sizes, out, heap) < 0);
+   t_assert("No blocks should be handed out", out[0] == NULL);
+   t_assert("Nothing should be left allocated", heap->free_list.size == 1);
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
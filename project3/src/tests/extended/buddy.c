@@ -0,0 +1,100 @@
+// REQUIRED-10: buddy allocator: page blocks split, coalesce and grow
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../buddy.h"
+
+#define SPACE_SIZE_INITIAL  (1 * 1024 * 1024)   // 1MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define BLOCKS              64
+
+int main(int argc, char **argv)
+{
+   // allocate space for the buddy allocator to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   void *blocks[BLOCKS];
+   int i;
+
+   struct buddy_heap *buddy = buddy_create(space,
+                                           space + SPACE_SIZE_INITIAL,
+                                           space + SPACE_SIZE_TOTAL);
+   t_assert("The buddy allocator should be created", buddy != NULL);
+   size_t initial_pages = buddy->free_pages;
+
+   // a request that rounds up to four pages
+   void *four = buddy_alloc(3 * PAGE_SIZE, buddy);
+   t_assert("The allocation should succeed", four != NULL);
+   t_assert("Blocks should be page-aligned", ((size_t)four & ~PAGE_MASK) == 0);
+   t_assert("The block should be rounded up to a power of two pages",
+            buddy_block_size(four, buddy) == 4 * PAGE_SIZE);
+   t_assert("Blocks should start at a multiple of their size",
+            ((four - buddy->base) % (4 * PAGE_SIZE)) == 0);
+
+   // take any lone free page, so that the next two pages come from splitting
+   // a larger block
+   void *lone = NULL;
+   if(buddy->free[0] != NULL) {
+      lone = buddy_alloc(PAGE_SIZE, buddy);
+   }
+
+   // the two halves of the split are handed out one after the other
+   void *page = buddy_alloc(PAGE_SIZE, buddy);
+   void *buddy_page = buddy_alloc(1, buddy);
+   t_assert("The allocations should succeed",
+            page != NULL && buddy_page != NULL);
+   t_assert("The second page should be the buddy of the first",
+            ((size_t)(buddy_page - buddy->base) ^ PAGE_SIZE) ==
+            (size_t)(page - buddy->base));
+   t_assert("Splitting should leave only buddy-sized pieces free",
+            buddy->free_pages == initial_pages - 6 - (lone != NULL));
+
+   // freeing everything coalesces back to the initial blocks
+   buddy_free(page, buddy);
+   buddy_free(four, buddy);
+   buddy_free(buddy_page, buddy);
+   buddy_free(lone, buddy);
+   t_assert("All pages should be free again",
+            buddy->free_pages == initial_pages);
+   t_assert("The first page should be a free block of the largest order "
+            "that fits",
+            buddy->map[0] & BUDDY_FREE &&
+            ((size_t)PAGE_SIZE << (buddy->map[0] & BUDDY_ORDER_MASK)) <=
+            SPACE_SIZE_INITIAL &&
+            ((size_t)PAGE_SIZE << (buddy->map[0] & BUDDY_ORDER_MASK)) * 2 >
+            SPACE_SIZE_INITIAL - 2 * PAGE_SIZE);
+
+   // pages that were never allocated are ignored
+   buddy_free(buddy->base, buddy);
+   t_assert("Freeing a free block should change nothing",
+            buddy->free_pages == initial_pages);
+
+   // allocating more than the initial region grows it
+   for(i = 0; i < BLOCKS; i++)
+   {
+      blocks[i] = buddy_alloc(16 * PAGE_SIZE, buddy);
+      t_assert("The allocation should succeed", blocks[i] != NULL);
+      *(int *)blocks[i] = i;
+   }
+   t_assert("The region should have grown",
+            buddy->end_address > space + SPACE_SIZE_INITIAL);
+   t_assert("The region should stay within its maximum",
+            buddy->end_address <= space + SPACE_SIZE_TOTAL);
+   t_assert("A request larger than the region should fail",
+            buddy_alloc(SPACE_SIZE_TOTAL, buddy) == NULL);
+
+   for(i = BLOCKS - 1; i >= 0; i--)
+   {
+      t_assert("The block should not have been overwritten",
+               *(int *)blocks[i] == i);
+      buddy_free(blocks[i], buddy);
+   }
+   t_assert("All pages should be free after the blocks are freed",
+            buddy->free_pages == (buddy->end_address - buddy->base) / PAGE_SIZE);
+
+   // free the space
+   free(space);
+
+   return 0;
+}
@@ -0,0 +1,125 @@
+// REQUIRED-10: free list storage grows and shrinks with the number of holes
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define ALLOCATIONS         2000
+#define ALLOCATION_SIZE     64
+
+#define SPACE_SIZE_FULL     (64 * 1024)         // 64KiB, with no room to grow
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   void *allocated[ALLOCATIONS];
+   struct heap_stats stats;
+   size_t failed = 0;
+   size_t freed;
+   size_t left;
+   int count;
+   int i;
+
+   // create the heap
+   struct heap *heap = heap_create(space,
+                                   space + SPACE_SIZE_INITIAL,
+                                   space + SPACE_SIZE_TOTAL);
+   void *initial = heap->free_list.storage;
+
+   t_assert("The free list should start small",
+            heap->free_list.max_size == HEAP_FREE_LIST_INITIAL);
+   t_assert("The data should start within a page of the heap struct",
+            heap->start_address <= space + sizeof(struct heap) + PAGE_SIZE +
+                                   FREE_LIST_ENTRY_SIZE *
+                                   HEAP_FREE_LIST_INITIAL);
+
+   for(i = 0; i < ALLOCATIONS; i++)
+   {
+      allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+      t_assert("The allocation should succeed", allocated[i] != NULL);
+      *(int *)allocated[i] = i;
+   }
+
+   // freeing every other block leaves a hole between each pair of blocks
+   for(i = 0; i < ALLOCATIONS; i += 2) {
+      kfree_heap(allocated[i], heap);
+   }
+   t_assert("Every freed block should be a hole in the free list",
+            heap->free_list.size >= ALLOCATIONS / 2);
+   t_assert("The free list should have grown to hold them",
+            heap->free_list.max_size >= heap->free_list.size);
+   t_assert("The grown free list should live in the heap",
+            (void *)heap->free_list.storage >= heap->start_address &&
+            (void *)heap->free_list.storage < heap->end_address);
+
+   for(i = 1; i < ALLOCATIONS; i += 2)
+   {
+      t_assert("The block should not have been overwritten",
+               *(int *)allocated[i] == i);
+      kfree_heap(allocated[i], heap);
+   }
+
+   // everything coalesces back into one hole, and the free list moves back
+   t_assert("Everything should coalesce into one hole",
+            heap->free_list.size == 1);
+   t_assert("The free list should be back in its initial storage",
+            heap->free_list.storage == initial &&
+            heap->free_list.max_size == HEAP_FREE_LIST_INITIAL);
+
+   // in a full heap that cannot grow, the free list cannot grow either; the
+   // frees that would need an entry it has no room for fail, and leave their
+   // blocks allocated, rather than leave a hole that cannot be allocated from
+   heap = heap_create(space, space + SPACE_SIZE_FULL, space + SPACE_SIZE_FULL);
+   for(count = 0; count < ALLOCATIONS; count++)
+   {
+      allocated[count] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+      if(allocated[count] == NULL) {
+         break;
+      }
+   }
+   t_assert("The heap should fill up", count < ALLOCATIONS);
+
+   for(i = 0; i < count; i += 2)
+   {
+      if(kfree_heap(allocated[i], heap) < 0) {
+         failed++;
+      }
+      else {
+         allocated[i] = NULL;
+      }
+   }
+   heap_stats(heap, &stats);
+   t_assert("Some frees should fail once the free list is full", failed > 0);
+   t_assert("The blocks that were not freed should stay allocated",
+            stats.blocks == count - (count + 1) / 2 + failed);
+   t_assert("Every hole should be in the free list",
+            stats.holes == heap->free_list.size);
+
+   // freeing blocks next to holes merges them, which makes room for the rest
+   do
+   {
+      freed = 0;
+      left = 0;
+      for(i = 0; i < count; i++)
+      {
+         if(allocated[i] != NULL && kfree_heap(allocated[i], heap) == 0)
+         {
+            allocated[i] = NULL;
+            freed++;
+         }
+         left += (allocated[i] != NULL);
+      }
+   } while(left > 0 && freed > 0);
+   t_assert("Every block should be freed in the end",
+            left == 0 && heap->free_list.size == 1);
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
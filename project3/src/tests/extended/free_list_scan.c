@@ -0,0 +1,156 @@
+// REQUIRED-5: every free list scan variant finds the same holes
+
+#include "../test.h"
+#include "../../free_list.h"
+
+#define HOLES      300
+#define MAX_SIZE   200
+
+// stand-ins for the holes; only their addresses are used
+char holes[HOLES];
+
+// returns 1 if the holes in the list are in order of size, then address,
+// stepping over vacant entries
+int in_order(struct free_list *list)
+{
+   size_t last = list->entries;
+   size_t i;
+
+   for(i = 0; i < list->entries; i++)
+   {
+      if(list->holes[i] == NULL) {
+         continue;
+      }
+
+      if(last < list->entries &&
+         !(list->sizes[last] < list->sizes[i] ||
+           (list->sizes[last] == list->sizes[i] &&
+            list->holes[last] < list->holes[i]))) {
+         return 0;
+      }
+      last = i;
+   }
+
+   return 1;
+}
+
+int main(int argc, char **argv)
+{
+   size_t storage[FREE_LIST_ENTRY_SIZE * HOLES / sizeof(size_t)];
+   size_t sizes[HOLES];
+   struct header *removed;
+   struct header *next;
+   u32int variant;
+   size_t size;
+   size_t i;
+
+   // sizes with many repeats, so holes of the same size are ordered by address
+   for(i = 0; i < HOLES; i++) {
+      sizes[i] = (i * 37) % MAX_SIZE;
+   }
+
+   for(variant = MEMSET_BYTES; variant <= memset_best(); variant++)
+   {
+      struct free_list list = free_list_place(storage, HOLES);
+
+      t_assert("A supported variant should be used as asked",
+               free_list_use(variant) == variant);
+
+      for(i = 0; i < HOLES; i++)
+      {
+         size_t at = (i * 101) % HOLES;
+
+         t_assert("The insert should succeed",
+                  free_list_insert((struct header *)&holes[at], sizes[at],
+                                   &list) == 0);
+      }
+      t_assert("A full list should refuse another hole",
+               free_list_insert((struct header *)&holes[0], 0, &list) < 0);
+
+      // the list is sorted by size, then address
+      t_assert("The holes should be in order", in_order(&list));
+
+      // the lower bound is the first hole that is large enough, at every size
+      for(size = 0; size <= MAX_SIZE + 1; size++)
+      {
+         size_t found = free_list_lower_bound(size, &list);
+
+         t_assert("The lower bound should be large enough",
+                  found == HOLES || list.sizes[found] >= size);
+         t_assert("The hole before the lower bound should be too small",
+                  found == 0 || list.sizes[found - 1] < size);
+      }
+      t_assert("A huge size should have no lower bound",
+               free_list_lower_bound((size_t)-1, &list) == HOLES);
+
+      // every hole is found, and only with its own size
+      for(i = 0; i < HOLES; i++)
+      {
+         size_t found = free_list_search((struct header *)&holes[i], sizes[i],
+                                         &list);
+
+         t_assert("Every hole should be found",
+                  found < HOLES && list.holes[found] == (void *)&holes[i]);
+         t_assert("A hole should not be found under another size",
+                  free_list_search((struct header *)&holes[i], sizes[i] + 1,
+                                   &list) == HOLES);
+      }
+
+      // a removal leaves its entry vacant without moving any other, and an
+      // insert of the same hole fills it again
+      removed = list.holes[HOLES / 2];
+      next = list.holes[HOLES / 2 + 1];
+      size = list.sizes[HOLES / 2];
+      free_list_remove(HOLES / 2, &list);
+      t_assert("The removed hole's entry should be vacant",
+               list.holes[HOLES / 2] == NULL && list.entries == HOLES);
+      t_assert("The other entries should not move",
+               list.holes[HOLES / 2 + 1] == next);
+      t_assert("A removed hole should not be found",
+               free_list_search(removed, size, &list) == list.entries);
+      free_list_insert(removed, size, &list);
+      t_assert("The insert should fill the vacant entry",
+               list.holes[HOLES / 2] == removed && list.entries == HOLES);
+
+      // removing holes keeps the rest in order and findable
+      for(i = 0; i < HOLES; i += 2)
+      {
+         free_list_remove(free_list_search((struct header *)&holes[i],
+                                           sizes[i], &list),
+                          &list);
+         t_assert("A removed hole should not be found",
+                  free_list_search((struct header *)&holes[i], sizes[i],
+                                   &list) == list.entries);
+      }
+      t_assert("Half of the holes should be left", list.size == HOLES / 2);
+      for(i = 1; i < HOLES; i += 2)
+      {
+         size_t found = free_list_search((struct header *)&holes[i], sizes[i],
+                                         &list);
+
+         t_assert("The other holes should still be found",
+                  found < list.entries &&
+                  list.holes[found] == (void *)&holes[i]);
+      }
+
+      // removals and inserts in turn, as allocations and frees do them
+      for(i = 0; i < HOLES; i += 2)
+      {
+         size_t other = (i + 101) | 1;
+
+         if(other < HOLES)
+         {
+            free_list_remove(free_list_search((struct header *)&holes[other],
+                                              sizes[other], &list),
+                             &list);
+            free_list_insert((struct header *)&holes[other], sizes[other],
+                             &list);
+         }
+         free_list_insert((struct header *)&holes[i], sizes[i], &list);
+      }
+      t_assert("Every hole should be back", list.size == HOLES);
+      t_assert("The holes should still be in order", in_order(&list));
+   }
+
+   return 0;
+}
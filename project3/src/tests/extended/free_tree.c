@@ -0,0 +1,105 @@
+// REQUIRED-10: free tree: best fit, coalescing and churn work with the tree index
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define ALLOCATIONS         2000
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   void *allocated[ALLOCATIONS];
+   int i;
+
+   // create the heap
+   struct heap *heap = heap_create_flags(space,
+                                         space + SPACE_SIZE_INITIAL,
+                                         space + SPACE_SIZE_TOTAL,
+                                         HEAP_FREE_TREE);
+
+   t_assert("No free list storage should be reserved",
+            heap->start_address < space + 2 * PAGE_SIZE);
+   t_assert("The tree should start with one hole",
+            heap->free_tree.size == 1);
+
+   // carve out a small and a large hole, separated by allocated blocks
+   void *small = kalloc_heap(100, 0, heap);
+   void *fence1 = kalloc_heap(20, 0, heap);
+   void *large = kalloc_heap(1000, 0, heap);
+   void *fence2 = kalloc_heap(20, 0, heap);
+   kfree_heap(large, heap);
+   kfree_heap(small, heap);
+   t_assert("There should be three holes",
+            heap->free_tree.size == 3);
+
+   // best fit: the small hole should be used, even though the large one comes
+   // first in the tree's insertion order
+   void *fit = kalloc_heap(90, 0, heap);
+   t_assert("The smallest fitting hole should be used", fit == small);
+   fit = kalloc_heap(500, 0, heap);
+   t_assert("The large hole should be used for a larger request",
+            fit == large);
+
+   kfree_heap(fit, heap);
+   kfree_heap(small, heap);
+   kfree_heap(fence1, heap);
+   kfree_heap(fence2, heap);
+   t_assert("Everything should coalesce into one hole",
+            heap->free_tree.size == 1);
+
+   // page alignment works through the tree as well
+   void *aligned = kalloc_heap(20, 1, heap);
+   t_assert("The aligned allocation should be aligned properly",
+            ((size_t)aligned & ~PAGE_MASK) == 0);
+   kfree_heap(aligned, heap);
+   t_assert("The aligned allocation should coalesce",
+            heap->free_tree.size == 1);
+
+   // churn: many allocations of mixed sizes, freed out of order, with the
+   // contents checked for overlap
+   srand(442);
+   for(i = 0; i < ALLOCATIONS; i++)
+   {
+      size_t size = sizeof(int) + rand() % 300;
+      allocated[i] = kalloc_heap(size, 0, heap);
+      t_assert("The allocation should succeed", allocated[i] != NULL);
+      t_assert("The allocation should be word-aligned",
+               ((size_t)allocated[i] % HEAP_TREE_ALIGN) == 0);
+      *(int *)allocated[i] = i;
+
+      // free a random earlier allocation now and then
+      if(i > 0 && rand() % 3 == 0)
+      {
+         int victim = rand() % i;
+         if(allocated[victim] != NULL)
+         {
+            t_assert("The allocation should not have been overwritten",
+                     *(int *)allocated[victim] == victim);
+            kfree_heap(allocated[victim], heap);
+            allocated[victim] = NULL;
+         }
+      }
+   }
+   for(i = 0; i < ALLOCATIONS; i++)
+   {
+      if(allocated[i] != NULL)
+      {
+         t_assert("The allocation should not have been overwritten",
+                  *(int *)allocated[i] == i);
+         kfree_heap(allocated[i], heap);
+      }
+   }
+   t_assert("Everything should coalesce into one hole after the churn",
+            heap->free_tree.size == 1);
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
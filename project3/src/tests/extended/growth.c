@@ -0,0 +1,84 @@
+// REQUIRED-5: heap growth: the top hole is tracked, and growth is geometric
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (64 * 1024)         // 64KiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define ALLOCATIONS         1000
+#define ALLOCATION_SIZE     4096
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   void *allocated[ALLOCATIONS];
+   size_t resizes = 0;
+   void *end;
+   int i;
+
+   // create the heap
+   struct heap *heap = heap_create(space,
+                                   space + SPACE_SIZE_INITIAL,
+                                   space + SPACE_SIZE_TOTAL);
+
+   t_assert("A new heap should be its top hole",
+            heap->top == heap->start_address);
+
+   // a run of allocations grows the heap by half its size each time
+   end = heap->end_address;
+   for(i = 0; i < ALLOCATIONS; i++)
+   {
+      allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+      t_assert("The allocation should succeed", allocated[i] != NULL);
+
+      if(heap->end_address != end)
+      {
+         resizes++;
+         end = heap->end_address;
+      }
+   }
+   t_assert("The heap should grow geometrically", resizes < 20);
+   t_assert("The top hole should be at the end of the heap",
+            heap->top != NULL &&
+            (void *)heap->top > allocated[ALLOCATIONS - 1]);
+
+   // freeing the last block merges it into the top hole
+   kfree_heap(allocated[ALLOCATIONS - 1], heap);
+   t_assert("The last block should be part of the top hole",
+            (void *)heap->top < allocated[ALLOCATIONS - 1]);
+
+   for(i = 0; i < ALLOCATIONS - 1; i++) {
+      kfree_heap(allocated[i], heap);
+   }
+   t_assert("Freeing every block should leave only the top hole",
+            heap->top == heap->start_address);
+
+   // with no growth policy, the heap grows by only what is needed
+   heap_set_growth(heap, 0, 0);
+   end = heap->end_address;
+   for(i = 0; i < ALLOCATIONS; i++)
+   {
+      allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+      t_assert("The allocation should succeed", allocated[i] != NULL);
+      t_assert("The heap should grow by no more than a block and a page",
+               heap->end_address - end <=
+               ALLOCATION_SIZE + HEAP_BLOCK_OVERHEAD + PAGE_SIZE);
+      end = heap->end_address;
+   }
+
+   // the heap never grows past its max address, however it grows
+   heap_set_growth(heap, 1000, 0);
+   while(kalloc_heap(ALLOCATION_SIZE, 0, heap) != NULL);
+   t_assert("The heap should not grow past its max address",
+            heap->end_address <= heap->max_address &&
+            heap->end_address > heap->max_address - 2 * PAGE_SIZE -
+                                ALLOCATION_SIZE);
+
+   free(space);
+
+   return 0;
+}
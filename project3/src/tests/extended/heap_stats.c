@@ -0,0 +1,72 @@
+// REQUIRED-5: heap_stats accounts for every block and hole in the heap
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define ALLOCATIONS         100
+#define ALLOCATION_SIZE     100
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   void *allocated[ALLOCATIONS];
+   struct heap_stats stats;
+   int i;
+
+   // create the heap
+   struct heap *heap = heap_create(space,
+                                   space + SPACE_SIZE_INITIAL,
+                                   space + SPACE_SIZE_TOTAL);
+
+   heap_stats(heap, &stats);
+   t_assert("A new heap should be one hole",
+            stats.blocks == 0 && stats.holes == 1 &&
+            stats.free == stats.size && stats.largest_hole == stats.size);
+
+   for(i = 0; i < ALLOCATIONS; i++) {
+      allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   }
+
+   // freeing every other block leaves a hole between each pair of blocks
+   for(i = 0; i < ALLOCATIONS; i += 2) {
+      kfree_heap(allocated[i], heap);
+   }
+
+   // the last block ends where the rest of the heap starts
+   void *last_end = allocated[ALLOCATIONS - 1] - sizeof(struct header) +
+                    heap_usable_size(allocated[ALLOCATIONS - 1]) +
+                    HEAP_BLOCK_OVERHEAD;
+
+   heap_stats(heap, &stats);
+   t_assert("Every block should be counted",
+            stats.blocks == ALLOCATIONS / 2);
+   t_assert("Every hole should be counted, and the rest of the heap",
+            stats.holes == ALLOCATIONS / 2 + 1);
+   t_assert("The blocks and holes should cover the heap",
+            stats.allocated + stats.free == stats.size);
+   t_assert("Each block should hold what was asked for",
+            stats.allocated >= ALLOCATIONS / 2 *
+                               (ALLOCATION_SIZE + HEAP_BLOCK_OVERHEAD));
+   t_assert("The largest hole should be the rest of the heap",
+            stats.largest_hole == heap->end_address - last_end);
+
+   for(i = 1; i < ALLOCATIONS; i += 2) {
+      kfree_heap(allocated[i], heap);
+   }
+
+   heap_stats(heap, &stats);
+   t_assert("Everything should coalesce into one hole",
+            stats.blocks == 0 && stats.holes == 1 &&
+            stats.free == stats.size);
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
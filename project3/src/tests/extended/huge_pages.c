@@ -0,0 +1,114 @@
+// REQUIRED-5: HEAP_HUGE_PAGES: only whole huge pages are committed and released
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (64 * 1024)         // 64KiB
+#define SPACE_SIZE_TOTAL    (64 * 1024 * 1024)  // 64MiB
+
+#define ALLOCATIONS         48
+#define ALLOCATION_SIZE     (1024 * 1024)       // 1MiB
+#define PACKED_SIZE         (3 * ALLOCATION_SIZE)
+
+// returns 1 if p is on a huge page boundary
+u8int huge_aligned(void *p)
+{
+   return ((size_t)p & (HEAP_HUGE_PAGE_SIZE - 1)) == 0;
+}
+
+int main(int argc, char **argv)
+{
+   void *allocated[ALLOCATIONS];
+   struct heap *heap;
+   size_t released;
+   void *p;
+   int i;
+
+   heap = heap_create_vm(SPACE_SIZE_INITIAL, SPACE_SIZE_TOTAL,
+                         HEAP_HUGE_PAGES);
+   t_assert("The heap should be created", heap != NULL);
+   t_assert("The heap should start on a huge page", huge_aligned(heap));
+   t_assert("A whole huge page should be committed",
+            heap->committed == (void *)heap + HEAP_HUGE_PAGE_SIZE);
+
+   for(i = 0; i < ALLOCATIONS; i++)
+   {
+      allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+      t_assert("The allocation should succeed", allocated[i] != NULL);
+      memset(allocated[i], i, ALLOCATION_SIZE);
+      t_assert("Only whole huge pages should be committed",
+               huge_aligned(heap->committed));
+   }
+
+   // holes of a megabyte cannot hold a whole huge page
+   for(i = 0; i < ALLOCATIONS; i += 2) {
+      kfree_heap(allocated[i], heap);
+   }
+   t_assert("Holes smaller than a huge page should not be released",
+            heap_scavenge(heap, (size_t)-1) == 0);
+
+   // coalescing them makes holes of several huge pages
+   for(i = 1; i < ALLOCATIONS / 2; i += 2) {
+      kfree_heap(allocated[i], heap);
+   }
+   released = heap_scavenge(heap, (size_t)-1);
+   t_assert("Whole huge pages should be released",
+            released >= HEAP_HUGE_PAGE_SIZE &&
+            released % HEAP_HUGE_PAGE_SIZE == 0);
+
+   for(i = ALLOCATIONS / 2 + 1; i < ALLOCATIONS; i += 2)
+   {
+      t_assert("Blocks in use should keep their contents",
+               ((u8int *)allocated[i])[0] == (u8int)i &&
+               ((u8int *)allocated[i])[ALLOCATION_SIZE - 1] == (u8int)i);
+      kfree_heap(allocated[i], heap);
+   }
+
+   t_assert("The heap should contract to whole huge pages",
+            huge_aligned(heap->committed) &&
+            heap->committed - heap->end_address <= 2 * HEAP_HUGE_PAGE_SIZE);
+
+   heap_destroy_vm(heap);
+
+   // allocations go to the holes whose pages are still in use before smaller
+   // holes that have been released; the heap grows by only what it needs, so
+   // that there is no large hole at the top
+   heap = heap_create_vm(SPACE_SIZE_INITIAL, SPACE_SIZE_TOTAL,
+                         HEAP_HUGE_PAGES);
+   t_assert("The heap should be created", heap != NULL);
+   heap_set_growth(heap, 0, 0);
+   for(i = 0; i < ALLOCATIONS; i++)
+   {
+      allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+      t_assert("The allocation should succeed", allocated[i] != NULL);
+   }
+
+   // a 4MiB hole is released, and an 8MiB hole is made afterwards
+   for(i = 2; i < 6; i++) {
+      kfree_heap(allocated[i], heap);
+   }
+   t_assert("The smaller hole should be released",
+            heap_scavenge(heap, (size_t)-1) > 0);
+   for(i = 10; i < 18; i++) {
+      kfree_heap(allocated[i], heap);
+   }
+
+   for(i = 0; i < 2; i++)
+   {
+      p = kalloc_heap(PACKED_SIZE, 0, heap);
+      t_assert("The block should go in the hole that is still backed",
+               p > allocated[9] && p < allocated[18]);
+   }
+
+   // once only the released hole fits, it is used rather than growing the heap
+   p = kalloc_heap(PACKED_SIZE, 0, heap);
+   t_assert("The block should go in the released hole",
+            p > allocated[1] && p < allocated[6]);
+
+   heap_destroy_vm(heap);
+
+   return 0;
+}
@@ -0,0 +1,67 @@
+// REQUIRED-5: every memcmp variant finds the first differing byte
+
+#include "../test.h"
+#include "../../memcmp.h"
+
+#define BUFFER_SIZE  400
+#define MAX_OFFSET   40
+#define MAX_LENGTH   300
+
+int main(int argc, char **argv)
+{
+   unsigned char a[BUFFER_SIZE];
+   unsigned char b[BUFFER_SIZE];
+   u32int variant;
+   size_t offset;
+   size_t length;
+   size_t diff;
+   size_t i;
+
+   for(i = 0; i < BUFFER_SIZE; i++)
+   {
+      a[i] = i * 13;
+      b[i] = i * 13;
+   }
+
+   for(variant = MEMSET_BYTES; variant <= memset_best(); variant++)
+   {
+      t_assert("A supported variant should be used as asked",
+               memcmp_use(variant) == variant);
+
+      for(offset = 0; offset < MAX_OFFSET; offset++)
+      {
+         for(length = 0; length < MAX_LENGTH; length++)
+         {
+            size_t other = (offset * 3 + length) % MAX_OFFSET;
+
+            // the areas are equal when they start at the same offset
+            t_assert("Equal areas should compare equal",
+                     memcmp(a + offset, b + offset, length) == 0);
+
+            // a difference at each position is found, with the right sign,
+            // and differences past the end are ignored
+            for(diff = 0; diff <= length; diff += 5)
+            {
+               b[offset + diff] ^= 0x80;
+               int result = memcmp(a + offset, b + offset, length);
+               int expected = (diff == length) ? 0 :
+                              (a[offset + diff] < b[offset + diff] ? -1 : 1);
+               b[offset + diff] ^= 0x80;
+
+               t_assert("The first difference should decide the result",
+                        (result < 0 ? -1 : result > 0) == expected);
+            }
+
+            // areas at different alignments
+            t_assert("Different areas should not compare equal",
+                     other == offset ||
+                     memcmp(a + offset, a + other, length + 1) != 0);
+         }
+      }
+   }
+
+   t_assert("Bytes should compare as unsigned chars",
+            memcmp("\x80", "\x01", 1) > 0);
+
+   return 0;
+}
@@ -0,0 +1,106 @@
+// REQUIRED-5: every memcpy and memmove variant copies exactly the requested bytes
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../memcpy.h"
+
+#define MEM_SIZE     (2 * MEMCPY_STREAM_SIZE + 8192)
+#define BUFFER_SIZE  512
+#define GUARD        0x5a
+#define MAX_OFFSET   40
+#define MAX_LENGTH   300
+
+// fills a buffer with a pattern that depends on the seed
+void pattern(unsigned char *memory, size_t n, size_t seed)
+{
+   size_t i;
+
+   for(i = 0; i < n; i++) {
+      memory[i] = (i * 7 + seed) & 0xff;
+   }
+}
+
+int main(int argc, char **argv)
+{
+   unsigned char *memory = malloc(MEM_SIZE);
+   unsigned char source[BUFFER_SIZE];
+   unsigned char expected[BUFFER_SIZE];
+   u32int variant;
+   size_t from;
+   size_t to;
+   size_t length;
+   size_t i;
+
+   for(variant = MEMSET_BYTES; variant <= memset_best(); variant++)
+   {
+      t_assert("A supported variant should be used as asked",
+               memcpy_use(variant) == variant);
+
+      // memcpy between separate buffers, at every alignment
+      for(to = 0; to < MAX_OFFSET; to++)
+      {
+         for(length = 0; length < MAX_LENGTH; length++)
+         {
+            from = (to * 5 + length) % MAX_OFFSET;
+            pattern(source, BUFFER_SIZE, length);
+            for(i = 0; i < BUFFER_SIZE; i++) {
+               memory[i] = GUARD;
+            }
+
+            t_assert("memcpy should return the destination",
+                     memcpy(memory + to, source + from, length) ==
+                     memory + to);
+            for(i = 0; i < BUFFER_SIZE; i++)
+            {
+               unsigned char want = (i >= to && i < to + length) ?
+                                    source[from + i - to] : GUARD;
+               t_assert("memcpy should copy exactly the requested bytes",
+                        memory[i] == want);
+            }
+         }
+      }
+
+      // memmove within one buffer, in both directions and at every overlap
+      for(from = 0; from < MAX_OFFSET; from++)
+      {
+         for(to = 0; to < MAX_OFFSET; to++)
+         {
+            for(length = 0; length < MAX_LENGTH; length += 7)
+            {
+               pattern(memory, BUFFER_SIZE, from + to);
+               for(i = 0; i < BUFFER_SIZE; i++)
+               {
+                  expected[i] = memory[i];
+               }
+               for(i = 0; i < length; i++) {
+                  expected[to + i] = memory[from + i];
+               }
+
+               t_assert("memmove should return the destination",
+                        memmove(memory + to, memory + from, length) ==
+                        memory + to);
+               for(i = 0; i < BUFFER_SIZE; i++)
+               {
+                  t_assert("memmove should copy as if through a buffer",
+                           memory[i] == expected[i]);
+               }
+            }
+         }
+      }
+
+      // a copy large enough for non-temporal stores, between odd addresses
+      pattern(memory, MEMCPY_STREAM_SIZE + 4096, 3);
+      memcpy(memory + MEMCPY_STREAM_SIZE + 4099, memory + 1,
+             MEMCPY_STREAM_SIZE + 1000);
+      for(i = 0; i < MEMCPY_STREAM_SIZE + 1000; i++)
+      {
+         t_assert("A large copy should copy every byte",
+                  memory[MEMCPY_STREAM_SIZE + 4099 + i] == memory[1 + i]);
+      }
+   }
+
+   free(memory);
+
+   return 0;
+}
@@ -0,0 +1,75 @@
+// REQUIRED-5: every memset variant fills exactly the requested bytes
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../memset.h"
+
+#define MEM_SIZE     (MEMSET_STREAM_SIZE + 4096)
+#define GUARD        0x5a
+#define MAX_OFFSET   64
+#define MAX_LENGTH   300
+
+// returns 1 if [start,start+n) holds c and the rest of the buffer holds the
+// guard byte
+int check(unsigned char *memory, size_t start, size_t n, int c, size_t size)
+{
+   size_t i;
+
+   for(i = 0; i < size; i++)
+   {
+      unsigned char expected = (i >= start && i < start + n) ? c : GUARD;
+
+      if(memory[i] != expected) {
+         return 0;
+      }
+   }
+
+   return 1;
+}
+
+int main(int argc, char **argv)
+{
+   unsigned char *memory = malloc(MEM_SIZE);
+   u32int variant;
+   size_t offset;
+   size_t length;
+
+   t_assert("The best variant should be at least word-wide",
+            memset_best() >= MEMSET_WORDS);
+
+   for(variant = MEMSET_BYTES; variant <= memset_best(); variant++)
+   {
+      t_assert("A supported variant should be used as asked",
+               memset_use(variant) == variant);
+
+      // every alignment of the head and tail, around the size where the
+      // vector loops start
+      for(offset = 0; offset < MAX_OFFSET; offset++)
+      {
+         for(length = 0; length < MAX_LENGTH; length++)
+         {
+            memset(memory, GUARD, MAX_OFFSET + MAX_LENGTH + 64);
+            t_assert("The pointer should be returned",
+                     memset(memory + offset, length & 0xff, length) ==
+                     memory + offset);
+            t_assert("Exactly the requested bytes should be set",
+                     check(memory, offset, length, length & 0xff,
+                           MAX_OFFSET + MAX_LENGTH + 64));
+         }
+      }
+
+      // a fill large enough for non-temporal stores, from an odd address
+      memset(memory, GUARD, MEM_SIZE);
+      memset(memory + 3, 0, MEMSET_STREAM_SIZE + 1000);
+      t_assert("A large fill should set exactly the requested bytes",
+               check(memory, 3, MEMSET_STREAM_SIZE + 1000, 0, MEM_SIZE));
+   }
+
+   t_assert("An unsupported variant should fall back to the best one",
+            memset_use(MEMSET_AVX2 + 1) == memset_best());
+
+   free(memory);
+
+   return 0;
+}
@@ -0,0 +1,116 @@
+// REQUIRED-10: krealloc_heap resizes in place when it can, and moves otherwise
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define ALLOCATION_SIZE     100
+
+// fills a block with a pattern that depends on the seed
+void pattern(unsigned char *p, size_t n, int seed)
+{
+   size_t i;
+
+   for(i = 0; i < n; i++) {
+      p[i] = i + seed;
+   }
+}
+
+// returns 1 if a block still holds the pattern
+int intact(unsigned char *p, size_t n, int seed)
+{
+   size_t i;
+
+   for(i = 0; i < n; i++)
+   {
+      if(p[i] != (unsigned char)(i + seed)) {
+         return 0;
+      }
+   }
+
+   return 1;
+}
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+
+   // create the heap
+   struct heap *heap = heap_create(space,
+                                   space + SPACE_SIZE_INITIAL,
+                                   space + SPACE_SIZE_TOTAL);
+
+   // three adjacent blocks and a fence, with a hole where the middle one was
+   void *allocated1 = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   void *allocated2 = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   void *allocated3 = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   void *fence = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   pattern(allocated1, ALLOCATION_SIZE, 1);
+   pattern(allocated3, ALLOCATION_SIZE, 3);
+   kfree_heap(allocated2, heap);
+
+   // growing into the hole keeps the block where it is
+   void *grown = krealloc_heap(allocated1, ALLOCATION_SIZE + 50, heap);
+   t_assert("The block should grow in place", grown == allocated1);
+   t_assert("The grown block should be large enough",
+            heap_usable_size(grown) >= ALLOCATION_SIZE + 50);
+   t_assert("The contents should be kept", intact(grown, ALLOCATION_SIZE, 1));
+   t_assert("The rest of the hole should still be a hole",
+            heap->free_list.size == 2);
+
+   // growing into the whole hole leaves no hole behind
+   grown = krealloc_heap(grown, 2 * ALLOCATION_SIZE + HEAP_BLOCK_OVERHEAD,
+                         heap);
+   t_assert("The block should take all of the hole", grown == allocated1);
+   t_assert("The hole should be gone", heap->free_list.size == 1);
+
+   // shrinking splits off a hole
+   void *shrunk = krealloc_heap(grown, ALLOCATION_SIZE / 2, heap);
+   t_assert("The block should shrink in place", shrunk == allocated1);
+   t_assert("The contents should be kept",
+            intact(shrunk, ALLOCATION_SIZE / 2, 1));
+   t_assert("The tail should be a hole again", heap->free_list.size == 2);
+   void *reused = kalloc_heap(ALLOCATION_SIZE / 2, 0, heap);
+   t_assert("The tail should be allocated from",
+            reused > shrunk && reused < allocated3);
+   kfree_heap(reused, heap);
+
+   // with no room on the right, the data moves
+   void *moved = krealloc_heap(allocated3, 4 * ALLOCATION_SIZE, heap);
+   t_assert("The block should move", moved != NULL && moved != allocated3);
+   t_assert("The moved contents should be kept",
+            intact(moved, ALLOCATION_SIZE, 3));
+
+   // a block followed by the hole at the end of the heap grows past the end of
+   // the heap in place
+   void *last = kalloc_heap((heap->end_address - heap->start_address) / 2, 0,
+                            heap);
+   void *end = heap->end_address;
+   void *bigger = krealloc_heap(last, (end - last) + PAGE_SIZE, heap);
+   t_assert("The last block should grow in place", bigger == last);
+   t_assert("The heap should have grown", heap->end_address > end);
+
+   // NULL and 0 behave as allocation and free
+   void *fresh = krealloc_heap(NULL, ALLOCATION_SIZE, heap);
+   t_assert("Resizing NULL should allocate", fresh != NULL);
+   t_assert("Resizing to 0 should free",
+            krealloc_heap(fresh, 0, heap) == NULL);
+
+   // everything coalesces back into one hole
+   kfree_heap(bigger, heap);
+   kfree_heap(moved, heap);
+   kfree_heap(fence, heap);
+   kfree_heap(shrunk, heap);
+   t_assert("Everything should coalesce into one hole",
+            heap->free_list.size == 1);
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
@@ -0,0 +1,96 @@
+// REQUIRED-10: regions bump-allocate, roll back, nest, and release in bulk
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../region.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define OBJECTS             1000
+#define OBJECT_SIZE         40
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   void *objects[OBJECTS];
+   int i;
+
+   // create the heap
+   struct heap *heap = heap_create(space,
+                                   space + SPACE_SIZE_INITIAL,
+                                   space + SPACE_SIZE_TOTAL);
+
+   struct region *region = region_create(0, heap);
+   t_assert("The region should be created", region != NULL);
+   struct region_mark empty = region_save(region);
+
+   // consecutive objects are handed out one after the other
+   void *first = region_alloc(OBJECT_SIZE, region);
+   void *second = region_alloc(OBJECT_SIZE, region);
+   t_assert("Objects should be aligned",
+            ((size_t)first & (REGION_ALIGN - 1)) == 0 &&
+            ((size_t)second & (REGION_ALIGN - 1)) == 0);
+   t_assert("Objects should be bumped from the same chunk",
+            second == first + ((OBJECT_SIZE + REGION_ALIGN - 1) &
+                               ~(REGION_ALIGN - 1)));
+
+   // enough objects to need several chunks
+   struct region_mark mark = region_save(region);
+   for(i = 0; i < OBJECTS; i++)
+   {
+      objects[i] = region_alloc(OBJECT_SIZE, region);
+      t_assert("The allocation should succeed", objects[i] != NULL);
+      *(int *)objects[i] = i;
+   }
+   for(i = 0; i < OBJECTS; i++)
+   {
+      t_assert("Objects should not overlap", *(int *)objects[i] == i);
+   }
+   t_assert("The region should have taken more chunks",
+            region->chunk != mark.chunk);
+
+   // an object larger than a chunk gets a chunk of its own
+   void *large = region_alloc(4 * REGION_CHUNK_SIZE, region);
+   t_assert("A large allocation should succeed", large != NULL);
+
+   // rolling back gives the new chunks back and reuses the space
+   region_rollback(mark, region);
+   t_assert("Rolling back should return to the save point",
+            region->chunk == mark.chunk && region->next == mark.next);
+   t_assert("The space should be reused",
+            region_alloc(OBJECT_SIZE, region) == objects[0]);
+
+   // a nested region is destroyed with its parent's reset
+   struct region *nested = region_create_nested(region);
+   struct region *nested2 = region_create_nested(region);
+   t_assert("The nested regions should be created",
+            nested != NULL && nested2 != NULL);
+   t_assert("The nested regions should be linked to the parent",
+            region->children == nested2 && nested2->next_sibling == nested);
+   t_assert("Nested allocations should succeed",
+            region_alloc(OBJECT_SIZE, nested) != NULL);
+   region_destroy(nested2);
+   t_assert("Destroying a nested region should unlink it",
+            region->children == nested && nested->prev_sibling == NULL);
+
+   region_reset(region);
+   t_assert("Resetting should destroy the nested regions",
+            region->children == NULL);
+   t_assert("Resetting should return to the start of the region",
+            region->chunk == empty.chunk && region->next == empty.next);
+   t_assert("The region should be usable after a reset",
+            region_alloc(OBJECT_SIZE, region) == first);
+
+   // destroying the region gives everything back
+   region_destroy(region);
+   t_assert("Everything should coalesce into one hole",
+            heap->free_list.size == 1);
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
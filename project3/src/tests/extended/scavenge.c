@@ -0,0 +1,133 @@
+// REQUIRED-5: heap_scavenge releases the memory inside large holes
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (64 * 1024)         // 64KiB
+#define SPACE_SIZE_TOTAL    (64 * 1024 * 1024)  // 64MiB
+
+#define ALLOCATIONS         200
+#define ALLOCATION_SIZE     (64 * 1024)         // 64KiB
+#define MORE_FREED          (HEAP_SCAVENGE_FREED / ALLOCATION_SIZE)
+#define SMALL_BUDGET        (10 * PAGE_SIZE)
+#define SMALL_CALLS         6
+
+u32int modes[] = { 0, HEAP_FREE_TREE, HEAP_SEGREGATED,
+                   HEAP_FREE_TREE | HEAP_SEGREGATED };
+
+// returns the number of pages of the heap's space that are backed by memory
+size_t resident_pages(struct heap *heap)
+{
+   static unsigned char pages[SPACE_SIZE_TOTAL / PAGE_SIZE];
+   size_t count = 0;
+   size_t i;
+
+   if(mincore(heap, SPACE_SIZE_TOTAL, pages) != 0) {
+      return 0;
+   }
+
+   for(i = 0; i < SPACE_SIZE_TOTAL / PAGE_SIZE; i++) {
+      count += pages[i] & 1;
+   }
+
+   return count;
+}
+
+int main(int argc, char **argv)
+{
+   void *allocated[ALLOCATIONS];
+   size_t mode;
+   size_t before;
+   size_t resident;
+   size_t released;
+   int i;
+
+   for(mode = 0; mode < sizeof(modes) / sizeof(modes[0]); mode++)
+   {
+      struct heap *heap = heap_create_vm(SPACE_SIZE_INITIAL, SPACE_SIZE_TOTAL,
+                                         modes[mode]);
+
+      t_assert("The heap should be created", heap != NULL);
+
+      for(i = 0; i < ALLOCATIONS; i++)
+      {
+         allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+         t_assert("The allocation should succeed", allocated[i] != NULL);
+         memset(allocated[i], i, ALLOCATION_SIZE);
+      }
+
+      // freeing every other block leaves large holes between blocks in use,
+      // which do not touch the end of the heap
+      for(i = 0; i < ALLOCATIONS; i += 2) {
+         kfree_heap(allocated[i], heap);
+      }
+
+      // a small budget releases a little at a time, and each call carries on
+      // where the last one stopped
+      before = resident_pages(heap);
+      resident = before;
+      for(i = 0; i < SMALL_CALLS; i++)
+      {
+         released = heap_scavenge(heap, SMALL_BUDGET);
+         t_assert("The whole budget should be released",
+                  released == SMALL_BUDGET);
+         t_assert("Each call should release more pages",
+                  resident_pages(heap) < resident);
+         resident = resident_pages(heap);
+      }
+
+      heap_scavenge(heap, (size_t)-1);
+      t_assert("The holes' pages should no longer be resident",
+               resident_pages(heap) <= before - (ALLOCATIONS / 2) *
+                                       (ALLOCATION_SIZE / PAGE_SIZE - 2));
+      t_assert("Scavenging again straight away should do nothing",
+               heap_scavenge(heap, (size_t)-1) == 0);
+
+      // free enough more for the scavenger to run again; the blocks are
+      // coalesced with the holes around them, and only that hole is new
+      for(i = 1; i < 1 + 2 * MORE_FREED; i += 2) {
+         kfree_heap(allocated[i], heap);
+      }
+      released = heap_scavenge(heap, (size_t)-1);
+      t_assert("Only the new hole should be released",
+               released >= MORE_FREED * (size_t)ALLOCATION_SIZE &&
+               released <= (2 * MORE_FREED + 2) * (size_t)ALLOCATION_SIZE);
+
+      // the blocks in use are untouched, and the holes can still be used
+      for(i = 1 + 2 * MORE_FREED; i < ALLOCATIONS; i += 2)
+      {
+         t_assert("Blocks in use should keep their contents",
+                  ((u8int *)allocated[i])[0] == (u8int)i &&
+                  ((u8int *)allocated[i])[ALLOCATION_SIZE - 1] == (u8int)i);
+      }
+      for(i = 0; i < ALLOCATIONS; i += 2)
+      {
+         allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+         t_assert("The holes should be allocated from again",
+                  allocated[i] != NULL);
+         memset(allocated[i], i, ALLOCATION_SIZE);
+      }
+
+      heap_destroy_vm(heap);
+   }
+
+   // a heap over memory it did not reserve is left alone
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   struct heap *heap = heap_create(space, space + SPACE_SIZE_TOTAL / 2,
+                                   space + SPACE_SIZE_TOTAL);
+   for(i = 0; i < ALLOCATIONS; i++) {
+      allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   }
+   for(i = 0; i < ALLOCATIONS; i += 2) {
+      kfree_heap(allocated[i], heap);
+   }
+   t_assert("Only HEAP_VM heaps should be scavenged",
+            heap_scavenge(heap, (size_t)-1) == 0);
+   free(space);
+
+   return 0;
+}
@@ -0,0 +1,86 @@
+// REQUIRED-10: segregated fit: small holes are kept in and served from bins
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define ALLOCATION_SIZE     20
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+
+   // create the heap
+   struct heap *heap = heap_create_flags(space,
+                                         space + SPACE_SIZE_INITIAL,
+                                         space + SPACE_SIZE_TOTAL,
+                                         HEAP_SEGREGATED);
+
+   // the block size of one allocation, rounded to the bin spacing
+   size_t total_size = ALLOCATION_SIZE + HEAP_BLOCK_OVERHEAD;
+   total_size = (total_size + HEAP_BIN_SPACING - 1) &
+                ~(size_t)(HEAP_BIN_SPACING - 1);
+   size_t bin = total_size / HEAP_BIN_SPACING;
+
+   // allocate three times; the allocations are adjacent
+   void *allocated1 = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   void *allocated2 = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   void *allocated3 = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   t_assert("The first and second allocations should be adjacent",
+            allocated1 + total_size == allocated2);
+   t_assert("The second and third allocations should be adjacent",
+            allocated2 + total_size == allocated3);
+   t_assert("The first requests should miss their empty bin",
+            heap->bins[bin].misses == 3 && heap->bins[bin].hits == 0);
+
+   // the freed block is small, so it goes into its bin, not the free list
+   kfree_heap(allocated2, heap);
+   t_assert("The freed block should be in its bin",
+            heap->bins[bin].holes == 1);
+   t_assert("The bin map should show the bin as non-empty",
+            heap->bin_map & ((u64int)1 << bin));
+   t_assert("Only the large hole should be in the free list",
+            heap->free_list.size == 1);
+
+   // the same size is served straight from the bin
+   void *allocated4 = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   t_assert("The fourth allocation should take the spot of the freed second"
+            " allocation", allocated4 == allocated2);
+   t_assert("The request should be counted as a hit",
+            heap->bins[bin].hits == 1);
+   t_assert("The bin should be empty again",
+            heap->bins[bin].holes == 0 &&
+            !(heap->bin_map & ((u64int)1 << bin)));
+
+   // a smaller request borrows from a larger bin
+   void *large = kalloc_heap(200, 0, heap);
+   void *fence = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   kfree_heap(large, heap);
+   void *small = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+   t_assert("The small request should be carved from the larger hole",
+            small == large);
+
+   // large requests still come from the free list
+   void *huge = kalloc_heap(4 * HEAP_BIN_LIMIT, 0, heap);
+   t_assert("The large allocation should succeed", huge != NULL);
+
+   // everything coalesces back into one hole
+   kfree_heap(small, heap);
+   kfree_heap(fence, heap);
+   kfree_heap(huge, heap);
+   kfree_heap(allocated1, heap);
+   kfree_heap(allocated3, heap);
+   kfree_heap(allocated4, heap);
+   t_assert("Everything should coalesce into one hole",
+            heap->free_list.size == 1 && heap->bin_map == 0);
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
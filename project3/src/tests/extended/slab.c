@@ -0,0 +1,91 @@
+// REQUIRED-10: slab caches: objects are packed without headers and reused
+
+#include <stdlib.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+#include "../../slab.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define OBJECT_SIZE         20
+#define OBJECT_ALIGN        8
+#define OBJECTS             1000
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   void *objects[OBJECTS];
+   int i;
+
+   // create the heap
+   struct heap *heap = heap_create(space,
+                                   space + SPACE_SIZE_INITIAL,
+                                   space + SPACE_SIZE_TOTAL);
+
+   struct slab_cache *cache = slab_cache_create(OBJECT_SIZE, OBJECT_ALIGN,
+                                                heap);
+   t_assert("The cache should be created", cache != NULL);
+   t_assert("The object size should be rounded to the alignment",
+            cache->object_size == 24);
+   t_assert("Objects that do not fit in a slab should be refused",
+            slab_cache_create(PAGE_SIZE, 0, heap) == NULL);
+   t_assert("Alignments that are not powers of two should be refused",
+            slab_cache_create(OBJECT_SIZE, 12, heap) == NULL);
+
+   // objects sit right next to each other, with no header or footer
+   void *object1 = slab_alloc(cache);
+   void *object2 = slab_alloc(cache);
+   t_assert("The objects should be adjacent",
+            object1 + cache->object_size == object2);
+   t_assert("The objects should be aligned",
+            ((size_t)object1 % OBJECT_ALIGN) == 0);
+
+   // a freed object is handed out again
+   slab_free(object1, cache);
+   t_assert("The freed object should be reused", slab_alloc(cache) == object1);
+   slab_free(object1, cache);
+   slab_free(object2, cache);
+
+   // fill several slabs; each object is written to check for overlap
+   for(i = 0; i < OBJECTS; i++)
+   {
+      objects[i] = slab_alloc(cache);
+      t_assert("The allocation should succeed", objects[i] != NULL);
+      *(int *)objects[i] = i;
+   }
+   t_assert("The objects should need several slabs",
+            cache->slabs == (OBJECTS + cache->per_slab - 1) / cache->per_slab);
+
+   // consecutive slabs are in consecutive pages of the heap
+   t_assert("The slabs should be packed page after page",
+            ((size_t)objects[cache->per_slab] & PAGE_MASK) ==
+            ((size_t)objects[0] & PAGE_MASK) + PAGE_SIZE);
+
+   // free every other object, then the rest; empty slabs go back to the heap,
+   // apart from the last one
+   for(i = 0; i < OBJECTS; i += 2)
+   {
+      t_assert("The object should not have been overwritten",
+               *(int *)objects[i] == i);
+      slab_free(objects[i], cache);
+   }
+   for(i = 1; i < OBJECTS; i += 2)
+   {
+      t_assert("The object should not have been overwritten",
+               *(int *)objects[i] == i);
+      slab_free(objects[i], cache);
+   }
+   t_assert("Only one empty slab should be kept", cache->slabs == 1);
+
+   slab_cache_destroy(cache);
+   t_assert("The heap should be one hole after the cache is destroyed",
+            heap->free_list.size == 1);
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
@@ -0,0 +1,80 @@
+// REQUIRED-5: sorted arrays insert, find and remove items by binary search
+
+#include "../test.h"
+#include "../../sorted_array.h"
+
+#define ITEMS 100
+
+char items[ITEMS];
+
+// orders items by their address
+s8int address_order(void *a, void *b)
+{
+   if(a == b) {
+      return 0;
+   }
+
+   return (a < b) ? -1 : 1;
+}
+
+// orders an item against a key that is an index into the items
+s8int before_index(void *item, void *key)
+{
+   return ((char *)item - items < *(int *)key) ? -1 : 1;
+}
+
+int main(int argc, char **argv)
+{
+   void *storage[ITEMS];
+   int i;
+
+   struct sorted_array array = sorted_array_place(storage, ITEMS,
+                                                  &address_order);
+
+   // insert in a scrambled order
+   for(i = 0; i < ITEMS; i++)
+   {
+      t_assert("The insert should succeed",
+               sorted_array_insert(&items[(i * 37) % ITEMS], &array) == 0);
+   }
+   t_assert("A full array should refuse another item",
+            sorted_array_insert(&items[0], &array) < 0);
+
+   for(i = 0; i < ITEMS; i++)
+   {
+      t_assert("The items should be sorted",
+               sorted_array_lookup(i, &array) == &items[i]);
+      t_assert("Each item should be found at its index",
+               sorted_array_search(&items[i], &array) == i);
+   }
+   t_assert("A missing item should not be found",
+            sorted_array_search(&array, &array) == array.size);
+
+   // lower bounds with a key that is not an item
+   for(i = 0; i <= ITEMS; i++)
+   {
+      t_assert("The lower bound should be the first item not before the key",
+               sorted_array_lower_bound(&i, &before_index, &array) == i);
+   }
+
+   // remove every other item
+   for(i = 0; i < ITEMS; i += 2) {
+      sorted_array_remove(sorted_array_search(&items[i], &array), &array);
+   }
+   t_assert("Half of the items should be left", array.size == ITEMS / 2);
+   for(i = 0; i < ITEMS / 2; i++)
+   {
+      t_assert("The rest should stay sorted",
+               sorted_array_lookup(i, &array) == &items[2 * i + 1]);
+   }
+
+   i = 10;
+   t_assert("The lower bound should skip to the next item that is left",
+            sorted_array_lower_bound(&i, &before_index, &array) == 5);
+
+   // removing a missing item does nothing
+   sorted_array_remove(sorted_array_search(&items[0], &array), &array);
+   t_assert("Nothing should be removed", array.size == ITEMS / 2);
+
+   return 0;
+}
@@ -0,0 +1,107 @@
+// REQUIRED-10: thread-safe calls: threads share a heap through their caches
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+#include "../../tcache.h"
+
+#define SPACE_SIZE_INITIAL  (5 * 1024 * 1024)   // 5MiB
+#define SPACE_SIZE_TOTAL    (10 * 1024 * 1024)  // 10MiB
+
+#define THREADS             4
+#define ROUNDS              2000
+#define LIVE                64
+
+struct heap *heap;
+
+// allocates and frees blocks of mixed sizes, checking that no other thread
+// writes to them
+void *worker(void *arg)
+{
+   size_t id = (size_t)arg;
+   unsigned char *live[LIVE] = { NULL };
+   size_t sizes[LIVE];
+   unsigned int seed = id;
+   int i;
+   size_t j;
+
+   for(i = 0; i < ROUNDS; i++)
+   {
+      int slot = rand_r(&seed) % LIVE;
+
+      if(live[slot] != NULL)
+      {
+         for(j = 0; j < sizes[slot]; j++) {
+            if(live[slot][j] != (unsigned char)id) {
+               return (void *)1;
+            }
+         }
+         kfree_heap_mt(live[slot], heap);
+      }
+
+      // mostly small blocks, with the odd large one
+      sizes[slot] = 1 + rand_r(&seed) % (rand_r(&seed) % 8 ? 300 : 5000);
+      live[slot] = kalloc_heap_mt(sizes[slot], 0, heap);
+      if(live[slot] == NULL) {
+         return (void *)1;
+      }
+      for(j = 0; j < sizes[slot]; j++) {
+         live[slot][j] = (unsigned char)id;
+      }
+   }
+
+   // the blocks left in the cache go back to the heap when the thread exits
+   for(i = 0; i < LIVE; i++) {
+      kfree_heap_mt(live[i], heap);
+   }
+
+   return NULL;
+}
+
+int main(int argc, char **argv)
+{
+   // allocate space for kmalloc to play with
+   void *space = malloc(SPACE_SIZE_TOTAL);
+   pthread_t threads[THREADS];
+   void *result;
+   size_t i;
+
+   // create the heap
+   heap = heap_create(space,
+                      space + SPACE_SIZE_INITIAL,
+                      space + SPACE_SIZE_TOTAL);
+
+   // a freed small block is reused from the cache, without going to the heap
+   void *allocated1 = kalloc_heap_mt(20, 0, heap);
+   t_assert("The first allocation should refill the cache",
+            tcache_self()->refills == 1);
+   kfree_heap_mt(allocated1, heap);
+   void *allocated2 = kalloc_heap_mt(20, 0, heap);
+   t_assert("The freed block should be reused", allocated2 == allocated1);
+   t_assert("The reuse should be a cache hit", tcache_self()->hits == 1);
+   kfree_heap_mt(allocated2, heap);
+
+   // after a flush, everything is back in the heap
+   tcache_flush();
+   t_assert("The heap should be one hole after the flush",
+            heap->free_list.size == 1);
+
+   for(i = 0; i < THREADS; i++) {
+      pthread_create(&threads[i], NULL, worker, (void *)i);
+   }
+   for(i = 0; i < THREADS; i++)
+   {
+      pthread_join(threads[i], &result);
+      t_assert("No thread should see its blocks overwritten", result == NULL);
+   }
+
+   t_assert("The heap should be one hole once all threads have exited",
+            heap->free_list.size == 1);
+
+   // free the heap space
+   free(space);
+
+   return 0;
+}
@@ -0,0 +1,127 @@
+// REQUIRED-5: heap_create_vm: pages are committed and decommitted with the heap
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../test.h"
+#include "../../kheap.h"
+
+#define SPACE_SIZE_INITIAL  (64 * 1024)         // 64KiB
+#define SPACE_SIZE_TOTAL    (64 * 1024 * 1024)  // 64MiB
+
+#define ALLOCATIONS         2000
+#define ALLOCATION_SIZE     8192
+#define CYCLES              100
+
+// returns the number of pages of the heap's space that are backed by memory
+size_t resident_pages(struct heap *heap)
+{
+   static unsigned char pages[SPACE_SIZE_TOTAL / PAGE_SIZE];
+   size_t count = 0;
+   size_t i;
+
+   if(mincore(heap, SPACE_SIZE_TOTAL, pages) != 0) {
+      return (size_t)-1;
+   }
+
+   for(i = 0; i < SPACE_SIZE_TOTAL / PAGE_SIZE; i++) {
+      count += pages[i] & 1;
+   }
+
+   return count;
+}
+
+// returns the number of pages of the heap's space that are committed
+size_t committed_pages(struct heap *heap)
+{
+   return (heap->committed - (void *)heap) / PAGE_SIZE;
+}
+
+int main(int argc, char **argv)
+{
+   void *allocated[ALLOCATIONS];
+   struct heap *heap;
+   void *committed;
+   size_t size;
+   void *p;
+   int i;
+
+   heap = heap_create_vm(SPACE_SIZE_INITIAL, SPACE_SIZE_TOTAL, 0);
+   t_assert("The heap should be created", heap != NULL);
+   t_assert("The heap should be marked as HEAP_VM", heap->flags & HEAP_VM);
+   t_assert("Only the initial size should be committed",
+            heap->committed == (void *)heap + SPACE_SIZE_INITIAL);
+
+   // growing the heap commits pages, and touching them backs them
+   for(i = 0; i < ALLOCATIONS; i++)
+   {
+      allocated[i] = kalloc_heap(ALLOCATION_SIZE, 0, heap);
+      t_assert("The allocation should succeed", allocated[i] != NULL);
+      memset(allocated[i], 0x5a, ALLOCATION_SIZE);
+   }
+   t_assert("The heap should be committed up to its end",
+            heap->committed >= heap->end_address);
+   t_assert("The blocks should be backed by memory",
+            resident_pages(heap) >=
+            ALLOCATIONS * (size_t)ALLOCATION_SIZE / PAGE_SIZE);
+
+   // a block too large for the top hole grows the heap by a step, and freeing
+   // it contracts the heap again; the step stays committed for the next one
+   size = (heap->end_address - heap->start_address) / 2;
+   p = kalloc_heap(size, 0, heap);
+   t_assert("The allocation should succeed", p != NULL);
+   kfree_heap(p, heap);
+   committed = heap->committed;
+   for(i = 0; i < CYCLES; i++)
+   {
+      p = kalloc_heap(size, 0, heap);
+      t_assert("The allocation should succeed", p != NULL);
+      t_assert("The step should still be committed",
+               heap->committed == committed);
+      kfree_heap(p, heap);
+      t_assert("The step should stay committed",
+               heap->committed == committed);
+   }
+
+   // contracting the heap gives the pages back
+   for(i = ALLOCATIONS - 1; i >= 0; i--) {
+      kfree_heap(allocated[i], heap);
+   }
+   t_assert("Only a little past the end should stay committed",
+            heap->committed - heap->end_address <= HEAP_DECOMMIT_THRESHOLD);
+   t_assert("Decommitted pages should not be backed by memory",
+            resident_pages(heap) <= committed_pages(heap));
+
+   // allocating and freeing at the end of the heap does not decommit and
+   // commit pages each time
+   p = kalloc_heap(HEAP_DECOMMIT_THRESHOLD / 4, 0, heap);
+   kfree_heap(p, heap);
+   committed = heap->committed;
+   for(i = 0; i < CYCLES; i++)
+   {
+      p = kalloc_heap(HEAP_DECOMMIT_THRESHOLD / 4, 0, heap);
+      t_assert("The allocation should succeed", p != NULL);
+      kfree_heap(p, heap);
+      t_assert("The committed pages should not change",
+               heap->committed == committed);
+   }
+
+   // the heap still cannot grow past its max address
+   t_assert("A block larger than the heap should be refused",
+            kalloc_heap(SPACE_SIZE_TOTAL, 0, heap) == NULL);
+
+   heap_destroy_vm(heap);
+
+   // with HEAP_POPULATE, committed pages are backed without being touched
+   heap = heap_create_vm(SPACE_SIZE_INITIAL, SPACE_SIZE_TOTAL, HEAP_POPULATE);
+   t_assert("The heap should be created", heap != NULL);
+   p = kalloc_heap(ALLOCATION_SIZE * 100, 0, heap);
+   t_assert("The allocation should succeed", p != NULL);
+   t_assert("Every committed page should be backed by memory",
+            resident_pages(heap) == committed_pages(heap));
+
+   heap_destroy_vm(heap);
+
+   return 0;
+}
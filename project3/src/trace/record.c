@@ -0,0 +1,607 @@
+// Trace recorder: preload into a program to record its allocations
+//
+//    LD_PRELOAD=trace/record.so KHEAP_TRACE=program.trace ./program
+//
+// malloc, calloc, realloc, free, posix_memalign, aligned_alloc and memalign
+// are passed on to the C library, and recorded as they return
+//
+// each process writes a trace of its own, named by KHEAP_TRACE with its
+// process id appended (program.trace.1234): the processes a program forks, and
+// the programs it runs, inherit the preload, and would otherwise write over
+// its trace. A forked child starts its trace afresh, and does not record
+// frees of the objects it inherited
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "trace.h"
+
+// records are buffered, and written out this many at a time
+#define RECORD_BUFFER       4096
+
+// the table from live pointers to object ids starts with this many slots, and
+// doubles when it is half full
+#define RECORD_TABLE_INITIAL (1 << 16)
+
+// allocations made while the C library's functions are being looked up are
+// served from here, and never freed
+#define RECORD_BOOTSTRAP    (64 * 1024)
+
+// the longest trace file name, process id included
+#define RECORD_NAME_MAX     4096
+
+// a live object
+struct record_slot
+{
+   void *p;   // NULL if the slot is empty
+   u32int id;
+};
+
+// the C library's functions
+void *(*real_malloc)(size_t) = NULL;
+void *(*real_calloc)(size_t, size_t) = NULL;
+void *(*real_realloc)(void *, size_t) = NULL;
+void (*real_free)(void *) = NULL;
+int (*real_posix_memalign)(void **, size_t, size_t) = NULL;
+void *(*real_aligned_alloc)(size_t, size_t) = NULL;
+void *(*real_memalign)(size_t, size_t) = NULL;
+
+pthread_mutex_t record_lock = PTHREAD_MUTEX_INITIALIZER;
+int record_fd = -1;
+u64int record_start;
+u32int record_next_id = 1;
+
+struct trace_record record_buffer[RECORD_BUFFER];
+size_t record_buffered = 0;
+
+struct record_slot *record_table = NULL;
+size_t record_table_size = 0;
+size_t record_table_used = 0;
+
+char record_bootstrap[RECORD_BOOTSTRAP];
+size_t record_bootstrap_used = 0;
+u8int record_resolving = 0;
+
+// set while a thread is inside the recorder, so that anything the C library
+// allocates on its behalf is not recorded
+__thread u8int record_busy = 0;
+
+// headers for local functions
+u64int record_now(void);
+void record_resolve(void);
+void *record_bootstrap_alloc(size_t size);
+u8int record_bootstrapped(void *p);
+void record_flush(void);
+void record_write(u8int op, u8int align, u32int id, size_t size);
+size_t record_hash(void *p);
+void record_table_grow(void);
+void record_add(void *p, u32int id);
+u32int record_take(void *p);
+u8int record_log2(size_t align);
+void record_alloc(void *p, size_t size, size_t align);
+void record_free(void *p);
+void record_open(void);
+void record_fork_prepare(void);
+void record_fork_parent(void);
+void record_fork_child(void);
+void record_start_trace(void) __attribute__((constructor));
+void record_stop_trace(void) __attribute__((destructor));
+
+// returns the current time in nanoseconds
+u64int record_now(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return (u64int)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+// looks up the C library's functions; dlsym may allocate while it does so
+void record_resolve(void)
+{
+   record_resolving = 1;
+   real_malloc = dlsym(RTLD_NEXT, "malloc");
+   real_calloc = dlsym(RTLD_NEXT, "calloc");
+   real_realloc = dlsym(RTLD_NEXT, "realloc");
+   real_free = dlsym(RTLD_NEXT, "free");
+   real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+   real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+   real_memalign = dlsym(RTLD_NEXT, "memalign");
+   record_resolving = 0;
+}
+
+// allocates from the bootstrap space, 16-byte aligned and zeroed
+void *record_bootstrap_alloc(size_t size)
+{
+   void *p;
+
+   size = (size + 15) & ~(size_t)15;
+   if(size > RECORD_BOOTSTRAP - record_bootstrap_used) {
+      return NULL;
+   }
+
+   p = record_bootstrap + record_bootstrap_used;
+   record_bootstrap_used += size;
+
+   return p;
+}
+
+// returns 1 if p came from the bootstrap space
+u8int record_bootstrapped(void *p)
+{
+   return (char *)p >= record_bootstrap &&
+          (char *)p < record_bootstrap + RECORD_BOOTSTRAP;
+}
+
+// writes out the buffered records
+// the lock must be held
+void record_flush(void)
+{
+   char *p = (char *)record_buffer;
+   size_t left = record_buffered * sizeof(struct trace_record);
+
+   while(left > 0 && record_fd >= 0)
+   {
+      ssize_t written = write(record_fd, p, left);
+
+      if(written <= 0) {
+         break;
+      }
+      p += written;
+      left -= written;
+   }
+
+   record_buffered = 0;
+}
+
+// adds a record to the buffer
+// the lock must be held
+void record_write(u8int op, u8int align, u32int id, size_t size)
+{
+   struct trace_record *record = &record_buffer[record_buffered++];
+
+   record->op = op;
+   record->align = align;
+   record->reserved = 0;
+   record->id = id;
+   record->size = size;
+   record->time = record_now() - record_start;
+
+   if(record_buffered == RECORD_BUFFER) {
+      record_flush();
+   }
+}
+
+// hashes a pointer to a slot in the table
+size_t record_hash(void *p)
+{
+   size_t h = (size_t)p >> 4;
+
+   h ^= h >> 17;
+   h *= 0x9e3779b97f4a7c15ULL;
+
+   return (h >> 20) & (record_table_size - 1);
+}
+
+// doubles the table, which lives in its own mapping so that it does not
+// recurse into malloc
+// the lock must be held
+void record_table_grow(void)
+{
+   struct record_slot *old = record_table;
+   size_t old_size = record_table_size;
+   size_t size = old_size ? 2 * old_size : RECORD_TABLE_INITIAL;
+   struct record_slot *table = mmap(NULL, size * sizeof(struct record_slot),
+                                    PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   size_t i;
+
+   if(table == MAP_FAILED) {
+      abort();
+   }
+
+   record_table = table;
+   record_table_size = size;
+
+   for(i = 0; i < old_size; i++)
+   {
+      if(old[i].p != NULL)
+      {
+         size_t slot = record_hash(old[i].p);
+
+         while(table[slot].p != NULL) {
+            slot = (slot + 1) & (size - 1);
+         }
+         table[slot] = old[i];
+      }
+   }
+
+   if(old != NULL) {
+      munmap(old, old_size * sizeof(struct record_slot));
+   }
+}
+
+// remembers that the object with the given id is at p
+// the lock must be held
+void record_add(void *p, u32int id)
+{
+   size_t slot;
+
+   if(2 * (record_table_used + 1) > record_table_size) {
+      record_table_grow();
+   }
+
+   slot = record_hash(p);
+   while(record_table[slot].p != NULL) {
+      slot = (slot + 1) & (record_table_size - 1);
+   }
+
+   record_table[slot].p = p;
+   record_table[slot].id = id;
+   record_table_used++;
+}
+
+// forgets the object at p, and returns its id, or 0 if it was not recorded
+// the lock must be held
+u32int record_take(void *p)
+{
+   size_t slot;
+   size_t next;
+   u32int id;
+
+   if(record_table_size == 0) {
+      return 0;
+   }
+
+   slot = record_hash(p);
+   while(record_table[slot].p != p)
+   {
+      if(record_table[slot].p == NULL) {
+         return 0;
+      }
+      slot = (slot + 1) & (record_table_size - 1);
+   }
+
+   id = record_table[slot].id;
+   record_table_used--;
+
+   // move later entries of the probe run back into the gap, so that no
+   // lookup stops early at it
+   next = slot;
+   while(1)
+   {
+      size_t home;
+
+      record_table[slot].p = NULL;
+      do
+      {
+         next = (next + 1) & (record_table_size - 1);
+         if(record_table[next].p == NULL) {
+            return id;
+         }
+         home = record_hash(record_table[next].p);
+      } while(((next - home) & (record_table_size - 1)) <
+              ((next - slot) & (record_table_size - 1)));
+
+      record_table[slot] = record_table[next];
+      slot = next;
+   }
+}
+
+// returns log2 of an alignment; alignments are powers of two
+u8int record_log2(size_t align)
+{
+   return (align == 0) ? 0 : __builtin_ctzl(align);
+}
+
+// records an allocation, if it succeeded
+// allocations made before the trace starts or after it stops are not
+// recorded, and neither are their frees
+void record_alloc(void *p, size_t size, size_t align)
+{
+   if(p == NULL || record_busy) {
+      return;
+   }
+
+   record_busy = 1;
+   pthread_mutex_lock(&record_lock);
+   if(record_fd >= 0)
+   {
+      record_add(p, record_next_id);
+      record_write(TRACE_ALLOC, record_log2(align), record_next_id++, size);
+   }
+   pthread_mutex_unlock(&record_lock);
+   record_busy = 0;
+}
+
+// records a free, of an object that was recorded
+void record_free(void *p)
+{
+   u32int id;
+
+   if(p == NULL || record_busy) {
+      return;
+   }
+
+   record_busy = 1;
+   pthread_mutex_lock(&record_lock);
+   id = record_take(p);
+   if(id != 0) {
+      record_write(TRACE_FREE, 0, id, 0);
+   }
+   pthread_mutex_unlock(&record_lock);
+   record_busy = 0;
+}
+
+void *malloc(size_t size)
+{
+   void *p;
+
+   if(real_malloc == NULL)
+   {
+      if(record_resolving) {
+         return record_bootstrap_alloc(size);
+      }
+      record_resolve();
+   }
+
+   p = real_malloc(size);
+   record_alloc(p, size, 0);
+
+   return p;
+}
+
+void *calloc(size_t n, size_t size)
+{
+   void *p;
+
+   if(real_calloc == NULL)
+   {
+      // the bootstrap space is zeroed, as calloc's memory has to be
+      if(record_resolving) {
+         return (size == 0 || n <= (size_t)-1 / size) ?
+                record_bootstrap_alloc(n * size) : NULL;
+      }
+      record_resolve();
+   }
+
+   p = real_calloc(n, size);
+   record_alloc(p, n * size, 0);
+
+   return p;
+}
+
+void *realloc(void *p, size_t size)
+{
+   void *moved;
+   u32int id;
+
+   if(real_realloc == NULL) {
+      record_resolve();
+   }
+
+   if(p == NULL) {
+      return malloc(size);
+   }
+
+   // an object from the bootstrap space moves to the C library's heap, as a
+   // new object; its size is not kept, so whatever followed it in the space
+   // is copied as well, up to the new size
+   if(record_bootstrapped(p))
+   {
+      size_t keep = record_bootstrap + record_bootstrap_used - (char *)p;
+
+      moved = malloc(size);
+      if(moved != NULL) {
+         memcpy(moved, p, (keep < size) ? keep : size);
+      }
+
+      return moved;
+   }
+
+   moved = real_realloc(p, size);
+
+   // realloc(p, 0) frees p, and may or may not return a new object
+   if(size == 0)
+   {
+      record_free(p);
+      record_alloc(moved, 0, 0);
+      return moved;
+   }
+   if(moved == NULL || record_busy) {
+      return moved;
+   }
+
+   record_busy = 1;
+   pthread_mutex_lock(&record_lock);
+   id = record_take(p);
+   if(id != 0)
+   {
+      // the object keeps its id wherever it ends up
+      record_add(moved, id);
+      record_write(TRACE_REALLOC, 0, id, size);
+   }
+   pthread_mutex_unlock(&record_lock);
+   record_busy = 0;
+
+   return moved;
+}
+
+void free(void *p)
+{
+   if(p == NULL || record_bootstrapped(p)) {
+      return;
+   }
+   if(real_free == NULL) {
+      record_resolve();
+   }
+
+   record_free(p);
+   real_free(p);
+}
+
+int posix_memalign(void **out, size_t align, size_t size)
+{
+   int result;
+
+   if(real_posix_memalign == NULL) {
+      record_resolve();
+   }
+
+   result = real_posix_memalign(out, align, size);
+   if(result == 0) {
+      record_alloc(*out, size, align);
+   }
+
+   return result;
+}
+
+void *aligned_alloc(size_t align, size_t size)
+{
+   void *p;
+
+   if(real_aligned_alloc == NULL) {
+      record_resolve();
+   }
+
+   p = real_aligned_alloc(align, size);
+   record_alloc(p, size, align);
+
+   return p;
+}
+
+void *memalign(size_t align, size_t size)
+{
+   void *p;
+
+   if(real_memalign == NULL) {
+      record_resolve();
+   }
+
+   p = real_memalign(align, size);
+   record_alloc(p, size, align);
+
+   return p;
+}
+
+// opens this process's trace file, and writes its header
+// the lock must be held
+void record_open(void)
+{
+   const char *name = getenv(TRACE_FILE_VARIABLE);
+   char path[RECORD_NAME_MAX];
+   char digits[24];
+   size_t length;
+   size_t count = 0;
+   pid_t pid = getpid();
+   struct trace_header header;
+
+   if(name == NULL) {
+      name = TRACE_DEFAULT_FILE;
+   }
+
+   // the name is followed by a dot and the process id; this is done by hand,
+   // as it may run in a child that has just forked, and must not allocate
+   do
+   {
+      digits[count++] = '0' + pid % 10;
+      pid /= 10;
+   } while(pid > 0);
+
+   length = strlen(name);
+   if(length + 1 + count + 1 > sizeof(path)) {
+      return;
+   }
+   memcpy(path, name, length);
+   path[length++] = '.';
+   while(count > 0) {
+      path[length++] = digits[--count];
+   }
+   path[length] = '\0';
+
+   record_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   record_start = record_now();
+
+   header.magic = TRACE_MAGIC;
+   header.version = TRACE_VERSION;
+   if(record_fd >= 0 && write(record_fd, &header, sizeof(header)) !=
+                        sizeof(header))
+   {
+      close(record_fd);
+      record_fd = -1;
+   }
+}
+
+// keeps the recorder's state still while a thread forks
+void record_fork_prepare(void)
+{
+   pthread_mutex_lock(&record_lock);
+}
+
+void record_fork_parent(void)
+{
+   pthread_mutex_unlock(&record_lock);
+}
+
+// starts a new trace in a child that has just forked; the buffered records,
+// the open file and the live objects are all the parent's
+void record_fork_child(void)
+{
+   record_buffered = 0;
+   if(record_fd >= 0)
+   {
+      close(record_fd);
+      record_fd = -1;
+   }
+
+   if(record_table != NULL) {
+      munmap(record_table, record_table_size * sizeof(struct record_slot));
+   }
+   record_table = NULL;
+   record_table_size = 0;
+   record_table_used = 0;
+   record_next_id = 1;
+
+   record_open();
+
+   pthread_mutex_unlock(&record_lock);
+}
+
+// opens the trace file and writes its header
+void record_start_trace(void)
+{
+   if(real_malloc == NULL) {
+      record_resolve();
+   }
+
+   record_busy = 1;
+   pthread_mutex_lock(&record_lock);
+
+   record_open();
+   pthread_atfork(&record_fork_prepare, &record_fork_parent,
+                  &record_fork_child);
+
+   pthread_mutex_unlock(&record_lock);
+   record_busy = 0;
+}
+
+// writes out whatever is left when the program exits
+void record_stop_trace(void)
+{
+   pthread_mutex_lock(&record_lock);
+
+   record_flush();
+   if(record_fd >= 0) {
+      close(record_fd);
+   }
+   record_fd = -1;
+
+   pthread_mutex_unlock(&record_lock);
+}
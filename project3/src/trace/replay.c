@@ -0,0 +1,200 @@
+// Trace replay: runs a recorded trace against a heap, and reports throughput,
+// footprint, and fragmentation over time
+//
+//    trace/replay program.trace.1234 [space MiB] [HEAP_* flags]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "trace.h"
+#include "../kheap.h"
+
+#define SPACE_SIZE_DEFAULT  1024              // MiB
+#define INITIAL_SIZE        (64 * 1024)       // 64KiB
+
+// the number of points the timeline is sampled at
+#define SAMPLES             20
+
+// returns the current time in nanoseconds
+double now(void)
+{
+   struct timespec t;
+
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// reads a whole trace
+// returns its records, and their number in count; NULL if the file cannot be
+// read or is not a trace
+struct trace_record *read_trace(const char *name, size_t *count)
+{
+   FILE *file = fopen(name, "rb");
+   struct trace_header header;
+   struct trace_record *records;
+   long length;
+
+   if(file == NULL) {
+      return NULL;
+   }
+
+   if(fread(&header, sizeof(header), 1, file) != 1 ||
+      header.magic != TRACE_MAGIC || header.version != TRACE_VERSION)
+   {
+      fclose(file);
+      return NULL;
+   }
+
+   fseek(file, 0, SEEK_END);
+   length = ftell(file) - sizeof(header);
+   fseek(file, sizeof(header), SEEK_SET);
+
+   // one byte more, so that an empty trace still gets a valid pointer
+   *count = length / sizeof(struct trace_record);
+   records = malloc(*count * sizeof(struct trace_record) + 1);
+   if(records == NULL ||
+      fread(records, sizeof(struct trace_record), *count, file) != *count)
+   {
+      free(records);
+      fclose(file);
+      return NULL;
+   }
+
+   fclose(file);
+
+   return records;
+}
+
+// prints one point of the timeline
+void sample(size_t op, struct trace_record *record, size_t live,
+            struct heap *heap)
+{
+   struct heap_stats stats;
+
+   heap_stats(heap, &stats);
+
+   printf("%10zu %10.1f %12zu %12zu %12zu %8.2f %8.2f\n", op,
+          record->time / 1e6, live, stats.size,
+          (size_t)(heap->committed - (void *)heap),
+          (stats.free == 0) ? 0 : 1 - (double)stats.largest_hole / stats.free,
+          (live == 0) ? 0 : (double)stats.size / live);
+}
+
+int main(int argc, char **argv)
+{
+   size_t space_size = (size_t)SPACE_SIZE_DEFAULT * 1024 * 1024;
+   u32int flags = 0;
+   struct trace_record *records;
+   size_t count;
+   u32int max_id = 0;
+   void **objects;
+   size_t *sizes;
+   size_t live = 0;
+   size_t peak = 0;
+   size_t peak_live = 0;
+   double elapsed = 0;
+   size_t i;
+
+   if(argc < 2)
+   {
+      printf("usage: %s trace [space MiB] [HEAP_* flags]\n", argv[0]);
+      return 1;
+   }
+   if(argc > 2) {
+      space_size = strtoul(argv[2], NULL, 0) * 1024 * 1024;
+   }
+   if(argc > 3) {
+      flags = strtoul(argv[3], NULL, 0);
+   }
+
+   records = read_trace(argv[1], &count);
+   if(records == NULL)
+   {
+      printf("%s is not a readable trace\n", argv[1]);
+      return 1;
+   }
+
+   // ids are handed out in order, so they index the objects directly
+   for(i = 0; i < count; i++)
+   {
+      if(records[i].id > max_id) {
+         max_id = records[i].id;
+      }
+   }
+   objects = calloc(max_id + 1, sizeof(void *));
+   sizes = calloc(max_id + 1, sizeof(size_t));
+
+   // the space is only reserved, and pages are committed as the heap grows
+   struct heap *heap = heap_create_vm(INITIAL_SIZE, space_size, flags);
+   if(objects == NULL || sizes == NULL || heap == NULL)
+   {
+      printf("could not allocate space for the replay\n");
+      return 1;
+   }
+
+   printf("%10s %10s %12s %12s %12s %8s %8s\n", "op", "trace ms",
+          "live bytes", "heap bytes", "committed", "frag", "overhead");
+
+   for(i = 0; i < count; i++)
+   {
+      struct trace_record *record = &records[i];
+      u32int id = record->id;
+      size_t alignment = (size_t)1 << record->align;
+      void *p = NULL;
+      double start;
+
+      start = now();
+      switch(record->op)
+      {
+         case TRACE_ALLOC:
+            p = objects[id] = kalloc_heap_aligned(record->size, alignment,
+                                                  heap);
+            break;
+         case TRACE_REALLOC:
+            p = krealloc_heap(objects[id], record->size, heap);
+            if(p != NULL || record->size == 0) {
+               objects[id] = p;
+            }
+            break;
+         case TRACE_FREE:
+            kfree_heap(objects[id], heap);
+            objects[id] = NULL;
+            break;
+      }
+      elapsed += now() - start;
+
+      if(record->op != TRACE_FREE && p == NULL && record->size != 0)
+      {
+         printf("the heap ran out of space at operation %zu\n", i);
+         return 1;
+      }
+
+      live -= sizes[id];
+      sizes[id] = (record->op == TRACE_FREE) ? 0 : record->size;
+      live += sizes[id];
+
+      if(heap->end_address - heap->start_address > peak) {
+         peak = heap->end_address - heap->start_address;
+      }
+      if(live > peak_live) {
+         peak_live = live;
+      }
+
+      if(i % ((count + SAMPLES - 1) / SAMPLES) == 0 || i == count - 1) {
+         sample(i, record, live, heap);
+      }
+   }
+
+   printf("\n%zu operations in %.1f ms: %.0f ops/s\n", count, elapsed / 1e6,
+          count / (elapsed / 1e9));
+   printf("peak heap %zu bytes, for a peak of %zu live bytes\n", peak,
+          peak_live);
+
+   heap_destroy_vm(heap);
+   free(objects);
+   free(sizes);
+   free(records);
+
+   return 0;
+}
@@ -0,0 +1,48 @@
+// Allocation traces: a compact binary record of a program's allocations
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "../common.h"
+
+// a trace file is a struct trace_header followed by one struct trace_record
+// for each operation, in the order they happened, in the byte order of the
+// machine that recorded it
+//
+// objects are identified by ids handed out in order of allocation, starting
+// at 1, so that a trace does not depend on where the recorded allocator put
+// things; a resized object keeps its id. Failed operations, and frees of NULL,
+// are not recorded
+
+#define TRACE_MAGIC   0x5254484b // "KHTR"
+#define TRACE_VERSION 1
+
+// operations
+#define TRACE_ALLOC   1 // allocate size bytes for a new object
+#define TRACE_FREE    2 // free an object
+#define TRACE_REALLOC 3 // resize an object to size bytes
+
+// the recorder writes to the file named by this environment variable, or by
+// TRACE_DEFAULT_FILE, with a dot and the process id appended
+#define TRACE_FILE_VARIABLE "KHEAP_TRACE"
+#define TRACE_DEFAULT_FILE  "kheap.trace"
+
+// the start of a trace file
+struct trace_header
+{
+   u32int magic;   // TRACE_MAGIC
+   u32int version; // TRACE_VERSION
+};
+
+// one operation
+struct trace_record
+{
+   u8int op;        // TRACE_ALLOC, TRACE_FREE or TRACE_REALLOC
+   u8int align;     // log2 of the alignment asked for, or 0 if none was
+   u16int reserved;
+   u32int id;       // the object
+   u64int size;     // the size asked for; 0 for TRACE_FREE
+   u64int time;     // nanoseconds since the trace started
+};
+
+#endif // TRACE_H
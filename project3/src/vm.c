@@ -0,0 +1,87 @@
+// Virtual memory - implementation
+
+#include "vm.h"
+
+#include <sys/mman.h>
+
+void *vm_reserve(size_t size, size_t alignment)
+{
+   size_t extra = (alignment > PAGE_SIZE) ? alignment : 0;
+   void *p;
+   void *aligned;
+
+   // the space is only accounted for once it is committed
+   p = mmap(NULL, size + extra, PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if(p == MAP_FAILED) {
+      return NULL;
+   }
+
+   // mmap only aligns to pages; a larger alignment is found inside a larger
+   // reservation, and the space on either side of it is given back
+   aligned = p;
+   if(extra > 0)
+   {
+      aligned = (void *)(((size_t)p + extra - 1) & ~(extra - 1));
+      if(aligned > p) {
+         munmap(p, aligned - p);
+      }
+      if(p + extra > aligned) {
+         munmap(aligned + size, p + extra - aligned);
+      }
+   }
+
+   return aligned;
+}
+
+void vm_use_huge_pages(void *addr, size_t size)
+{
+#ifdef MADV_HUGEPAGE
+   madvise(addr, size, MADV_HUGEPAGE);
+#endif
+}
+
+s8int vm_commit(void *addr, size_t size, u8int populate)
+{
+   size_t i;
+
+   if(mprotect(addr, size, PROT_READ | PROT_WRITE) != 0) {
+      return -1;
+   }
+
+   if(!populate) {
+      return 0;
+   }
+
+#ifdef MADV_POPULATE_WRITE
+   if(madvise(addr, size, MADV_POPULATE_WRITE) == 0) {
+      return 0;
+   }
+#endif
+
+   // older kernels cannot populate a range in one call; writing to each page
+   // faults it in. The pages are not in use yet, so they hold only zeroes
+   for(i = 0; i < size; i += PAGE_SIZE) {
+      *(volatile u8int *)(addr + i) = 0;
+   }
+
+   return 0;
+}
+
+void vm_decommit(void *addr, size_t size)
+{
+   madvise(addr, size, MADV_DONTNEED);
+   mprotect(addr, size, PROT_NONE);
+}
+
+void vm_purge(void *addr, size_t size)
+{
+   // MADV_FREE would leave the pages in place until the OS is short of memory,
+   // so the heap's footprint would not go down until then
+   madvise(addr, size, MADV_DONTNEED);
+}
+
+void vm_release(void *addr, size_t size)
+{
+   munmap(addr, size);
+}
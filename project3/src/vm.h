@@ -0,0 +1,45 @@
+// Virtual memory: reserving address space, and committing pages of it
+
+#ifndef VM_H
+#define VM_H
+
+#include "common.h"
+
+// address space is reserved without any memory behind it, and cannot be
+// touched until it is committed; committed pages are backed by memory as they
+// are first touched (or straight away, if populate is set), and decommitted
+// pages go back to the OS and read as zeroes once they are committed again
+//
+// addresses and sizes are multiples of PAGE_SIZE
+//
+// this is the Linux (mmap) implementation of the paging code the kernel heap
+// would use
+
+// reserves size bytes of address space, starting at a multiple of alignment
+// (a power of two)
+// returns the start of the space, or NULL if it cannot be reserved
+void *vm_reserve(size_t size, size_t alignment);
+
+// asks for [addr, addr + size) to be backed by huge pages where it can be
+// the range should be aligned to huge pages; this has no effect if the OS
+// does not support them
+void vm_use_huge_pages(void *addr, size_t size);
+
+// makes [addr, addr + size) of reserved space usable; if populate is set, the
+// pages are backed by memory before this returns, so that touching them later
+// does not fault
+// returns a negative value if the pages cannot be committed, 0 on success
+s8int vm_commit(void *addr, size_t size, u8int populate) WARN_UNUSED;
+
+// gives the memory behind [addr, addr + size) back to the OS, and makes the
+// space unusable until it is committed again
+void vm_decommit(void *addr, size_t size);
+
+// gives the memory behind [addr, addr + size) back to the OS, but leaves the
+// pages committed; they read as zeroes when they are next touched
+void vm_purge(void *addr, size_t size);
+
+// releases space reserved with vm_reserve, committed or not
+void vm_release(void *addr, size_t size);
+
+#endif // VM_H